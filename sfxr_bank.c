@@ -0,0 +1,105 @@
+// command line front end for sfxr_ExportBank
+// generates a bank of preset sounds (and mutations of them) and writes one wav per sound,
+// or a single packed sound bank (see sfxr_WriteBank) if the output ends in .sfxb
+//
+// usage: sfxr_bank <count> <output directory or .sfxb file> [wav bits] [sample rate] [threads] [seed]
+
+#include "sfxr_soundeffects.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef int (*sfxr_Preset)(sfxr_Settings * dst);
+
+static const struct { const char * name; sfxr_Preset generate; } presets[] =
+{
+	{ "coin",		sfxr_Coin },
+	{ "laser",		sfxr_Laser },
+	{ "explosion",	sfxr_Explosion },
+	{ "powerup",	sfxr_Powerup },
+	{ "hit",		sfxr_Hit },
+	{ "jump",		sfxr_Jump },
+	{ "blip",		sfxr_Blip },
+	{ "random",		sfxr_Randomize },
+};
+
+enum
+{
+	PRESET_COUNT = sizeof(presets) / sizeof(presets[0]),
+	NAME_LENGTH = FILENAME_MAX
+};
+
+int main(int argc, char ** argv)
+{
+	if(argc < 3)
+	{
+		fprintf(stderr, "usage: %s <count> <output directory or .sfxb file> [wav bits] [sample rate] [threads] [seed]\n", argv[0]);
+		return 1;
+	}
+
+	int count		= atoi(argv[1]);
+	const char * directory = argv[2];
+	size_t directory_length = strlen(directory);
+	int packed = directory_length > 5 && strcmp(directory + directory_length - 5, ".sfxb") == 0;
+	int wav_bits	= argc > 3? atoi(argv[3]) : 16;
+	int sample_rate = argc > 4? atoi(argv[4]) : 44100;
+	int threads		= argc > 5? atoi(argv[5]) : 0;
+	unsigned int seed = argc > 6? (unsigned int)strtoul(argv[6], NULL, 10) : 1;
+
+	if(count <= 0)
+	{
+		fprintf(stderr, "count must be positive\n");
+		return 1;
+	}
+
+	sfxr_Settings * settings = malloc(count * sizeof(sfxr_Settings));
+	char * names = malloc((size_t)count * NAME_LENGTH);
+	const char ** filenames = malloc(count * sizeof(char const*));
+
+	if(!settings || !names || !filenames)
+	{
+		fprintf(stderr, "out of memory\n");
+		return 1;
+	}
+
+// every other sound in a row is a mutation of the one before it
+	sfxr_Seed(seed);
+	for(int i = 0; i < count; ++i)
+	{
+		int preset = (i / 2) % PRESET_COUNT;
+		int mutated = i & 1;
+
+		if(mutated)
+			sfxr_Mutate(&settings[i], &settings[i-1]);
+		else
+			presets[preset].generate(&settings[i]);
+
+		filenames[i] = names + (size_t)i * NAME_LENGTH;
+		if(packed)
+			snprintf(names + (size_t)i * NAME_LENGTH, NAME_LENGTH, "%s%s_%05d",
+				presets[preset].name, mutated? "_mutated" : "", i);
+		else
+			snprintf(names + (size_t)i * NAME_LENGTH, NAME_LENGTH, "%s/%s%s_%05d.wav",
+				directory, presets[preset].name, mutated? "_mutated" : "", i);
+	}
+
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	int failed = packed?
+		(sfxr_WriteBank(directory, settings, filenames, count, wav_bits, sample_rate) < 0? count : 0) :
+		sfxr_ExportBank(settings, filenames, count, wav_bits, sample_rate, threads);
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+
+	printf("{\"sounds\": %d, \"failed\": %d, \"seconds\": %f, \"sounds_per_sec\": %f}\n",
+		count, failed, seconds, count / seconds);
+
+	free(filenames);
+	free(names);
+	free(settings);
+
+	return failed != 0;
+}
@@ -0,0 +1,332 @@
+// micro benchmarks for every stage of synthesis and export
+// each case is run until it has taken at least the minimum time, then one json object is printed per line:
+//   {"bench": "synth", "case": "square_lowpass", "samples": ..., "seconds": ..., "samples_per_sec": ..., "ns_per_sample": ...}
+// for sfxr_ComputeRemainingSamples a "sample" is one call, randomize_stepped is the per sample loop it replaced.
+//
+// usage: sfxr_bench [seconds per case] [only cases containing this]
+
+#include "sfxr_soundeffects.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+enum
+{
+	MAX_SAMPLES		= 44100 * 4,
+	BLOCK_LENGTH	= 4096,
+	VOICES			= 16,
+	REMAINING_SOUNDS = 256
+};
+
+static float buffer[MAX_SAMPLES];
+static float resampled[MAX_SAMPLES * 2];
+static unsigned char quantized[MAX_SAMPLES * 4];
+static float voice_buffers[VOICES][MAX_SAMPLES];
+
+static sfxr_Wavetable triangle;
+static float wavetable_arena[SFXR_WAVETABLE_MAX_LENGTH * 2];
+
+static double min_seconds = 0.25;
+static const char * only = NULL;
+
+static double Now(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+static int Wanted(const char * bench, const char * name)
+{
+	return only == NULL || strstr(bench, only) || strstr(name, only);
+}
+
+static void Report(const char * bench, const char * name, long long samples, double seconds)
+{
+	printf("{\"bench\": \"%s\", \"case\": \"%s\", \"samples\": %lld, \"seconds\": %f, \"samples_per_sec\": %f, \"ns_per_sample\": %f}\n",
+		bench, name, samples, seconds, samples / seconds, seconds * 1e9 / samples);
+	fflush(stdout);
+}
+
+/*
+ * synthesis
+ */
+
+typedef void (*Feature)(sfxr_Settings * settings);
+
+static void Plain(sfxr_Settings * s)		{ (void)s; }
+static void LowPass(sfxr_Settings * s)		{ s->lowPassFilter.cutoffFrequencyHz = 2000; s->lowPassFilter.resonancePercent = 50; }
+static void HighPass(sfxr_Settings * s)		{ s->highPassFilter.cutoffFrequencyHz = 500; }
+static void Filters(sfxr_Settings * s)		{ LowPass(s); HighPass(s); }
+static void Phaser(sfxr_Settings * s)		{ s->flanger.offsetMs_sec = 5; s->flanger.sweepMs_sec2 = 1; }
+static void Retrigger(sfxr_Settings * s)	{ s->retrigger.rateHz = 20; }
+static void Arpeggio(sfxr_Settings * s)		{ s->arpeggiation.frequencySemitones = 7; s->arpeggiation.speedSec = 0.05f; }
+static void Everything(sfxr_Settings * s)	{ Filters(s); Phaser(s); Retrigger(s); Arpeggio(s); }
+
+static const struct { const char * name; enum sfxr_WaveType type; } waves[] =
+{
+	{ "square",		sfxr_Square },
+	{ "sawtooth",	sfxr_Sawtooth },
+	{ "sine",		sfxr_Sine },
+	{ "noise",		sfxr_Noise },
+	{ "table",		sfxr_Table },
+};
+
+static const struct { const char * name; Feature apply; } features[] =
+{
+	{ "plain",		Plain },
+	{ "lowpass",	LowPass },
+	{ "highpass",	HighPass },
+	{ "filters",	Filters },
+	{ "phaser",		Phaser },
+	{ "retrigger",	Retrigger },
+	{ "arpeggio",	Arpeggio },
+	{ "everything", Everything },
+};
+
+// a steady two second note, so the sound doesn't end before the buffer does
+static void MakeSettings(sfxr_Settings * settings, enum sfxr_WaveType wave, Feature feature)
+{
+	sfxr_Init(settings);
+	settings->wave_type = wave;
+	settings->envelope.attackSec = 0.01f;
+	settings->envelope.sustainSec = 2.0f;
+	settings->envelope.decaySec = 1.0f;
+	settings->frequency.baseHz = 440;
+	settings->vibrato.strengthPercent = 10;
+	settings->vibrato.speedHz = 6;
+	feature(settings);
+}
+
+static void BenchSynth(const char * name, sfxr_Settings const* settings, enum sfxr_Oscillator oscillator)
+{
+	sfxr_Model model;
+	sfxr_Data data;
+	long long samples = 0;
+
+	sfxr_ModelInit(&model, settings);
+	sfxr_ModelSetWavetable(&model, &triangle);
+	model.oscillator = oscillator;
+
+	double start = Now(), end;
+	do
+	{
+		sfxr_DataInit(&data, &model);
+
+		int written;
+		while((written = sfxr_DataSynthSample(&data, BLOCK_LENGTH, buffer)) > 0)
+			samples += written;
+	} while((end = Now()) - start < min_seconds);
+
+	Report(oscillator == sfxr_BandLimited? "synth_bandlimited" : "synth", name, samples, end - start);
+}
+
+static void BenchMulti(void)
+{
+	static sfxr_Settings settings[VOICES];
+	static sfxr_Model models[VOICES];
+	static sfxr_Data data[VOICES];
+	sfxr_Data * voices[VOICES];
+	float * buffers[VOICES];
+	int written[VOICES];
+	long long samples = 0;
+
+	for(int v = 0; v < VOICES; ++v)
+	{
+		MakeSettings(&settings[v], waves[v % 5].type, features[v % 8].apply);
+		sfxr_ModelInit(&models[v], &settings[v]);
+		sfxr_ModelSetWavetable(&models[v], &triangle);
+		voices[v] = &data[v];
+		buffers[v] = voice_buffers[v];
+	}
+
+	double start = Now(), end;
+	do
+	{
+		for(int v = 0; v < VOICES; ++v)
+			sfxr_DataInit(&data[v], &models[v]);
+
+		sfxr_DataSynthSampleMulti(voices, VOICES, MAX_SAMPLES, buffers, written);
+
+		for(int v = 0; v < VOICES; ++v)
+			samples += written[v];
+	} while((end = Now()) - start < min_seconds);
+
+	Report("synth_multi", "mixed_16_voices", samples, end - start);
+}
+
+/*
+ * everything after synthesis
+ */
+
+typedef int (*Remaining)(sfxr_Data const* data);
+
+static void BenchRemaining(const char * name, Remaining remaining)
+{
+	static sfxr_Model models[REMAINING_SOUNDS];
+	sfxr_Settings settings;
+	sfxr_Data data;
+	long long calls = 0;
+	volatile int total = 0;
+
+	sfxr_Seed(1);
+	for(int i = 0; i < REMAINING_SOUNDS; ++i)
+	{
+		sfxr_Randomize(&settings);
+		sfxr_ModelInit(&models[i], &settings);
+	}
+
+	double start = Now(), end;
+	do
+	{
+		for(int i = 0; i < REMAINING_SOUNDS; ++i)
+		{
+			sfxr_DataInit(&data, &models[i]);
+			total += remaining(&data);
+		}
+		calls += REMAINING_SOUNDS;
+	} while((end = Now()) - start < min_seconds);
+
+	Report("compute_remaining", name, calls, end - start);
+}
+
+// fills buffer with something that isn't silence for the stages after synthesis
+static int FillBuffer(void)
+{
+	sfxr_Settings settings;
+	sfxr_Model model;
+	sfxr_Data data;
+
+	MakeSettings(&settings, sfxr_Sawtooth, Everything);
+	sfxr_ModelInit(&model, &settings);
+	sfxr_DataInit(&data, &model);
+
+	int length = sfxr_DataSynthSample(&data, MAX_SAMPLES, buffer);
+	memset(buffer + length, 0, (MAX_SAMPLES - length) * sizeof(float));
+	return MAX_SAMPLES;
+}
+
+static void BenchDownsample(int rate)
+{
+	char name[32];
+	long long samples = 0;
+	int length = FillBuffer();
+
+	snprintf(name, sizeof(name), "44100_to_%d", rate);
+
+	double start = Now(), end;
+	do
+	{
+		sfxr_Downsample(resampled, sizeof(resampled) / sizeof(float), buffer, length, rate, 44100);
+		samples += length;
+	} while((end = Now()) - start < min_seconds);
+
+	Report("downsample", name, samples, end - start);
+}
+
+static void BenchQuantize(const char * name, enum sfxr_SampleFormat format, int dithered)
+{
+	sfxr_Dither dither;
+	long long samples = 0;
+	int length = FillBuffer();
+
+	sfxr_DitherInit(&dither, 1);
+
+	double start = Now(), end;
+	do
+	{
+		sfxr_Quantize(quantized, buffer, length, format, dithered? &dither : NULL);
+		samples += length;
+	} while((end = Now()) - start < min_seconds);
+
+	Report("quantize", name, samples, end - start);
+}
+
+// counts the samples synthesized (at 44100) for each file, whatever rate it's written at
+static void BenchExport(const char * filename, int wav_bits, int sample_rate)
+{
+	char name[32];
+	sfxr_Settings settings;
+	sfxr_Model model;
+	sfxr_Data data;
+	long long samples = 0;
+
+	MakeSettings(&settings, sfxr_Square, Filters);
+	sfxr_ModelInit(&model, &settings);
+	sfxr_DataInit(&data, &model);
+	int length = sfxr_ComputeRemainingSamples(&data);
+
+	snprintf(name, sizeof(name), "%d_bit_%d", wav_bits, sample_rate);
+
+	double start = Now(), end;
+	do
+	{
+		if(sfxr_ExportWAV(&settings, wav_bits, sample_rate, filename) < 0)
+		{
+			fprintf(stderr, "can't write %s\n", filename);
+			return;
+		}
+		samples += length;
+	} while((end = Now()) - start < min_seconds);
+
+	remove(filename);
+	Report("export_wav", name, samples, end - start);
+}
+
+int main(int argc, char ** argv)
+{
+	if(argc > 1) min_seconds = atof(argv[1]);
+	if(argc > 2) only = argv[2];
+
+	if(min_seconds <= 0)
+	{
+		fprintf(stderr, "usage: %s [seconds per case] [only cases containing this]\n", argv[0]);
+		return 1;
+	}
+
+// a nes style triangle for the table cases
+	float steps[32];
+	for(int i = 0; i < 32; ++i)
+		steps[i] = ((i < 16? 15 - i : i - 16) - 7.5f) / 7.5f;
+	sfxr_WavetableInit(&triangle, wavetable_arena, SFXR_WAVETABLE_MAX_LENGTH * 2, steps, 32, 2048);
+
+	for(unsigned w = 0; w < sizeof(waves) / sizeof(waves[0]); ++w)
+	{
+		for(unsigned f = 0; f < sizeof(features) / sizeof(features[0]); ++f)
+		{
+			char name[64];
+			snprintf(name, sizeof(name), "%s_%s", waves[w].name, features[f].name);
+
+			sfxr_Settings settings;
+			MakeSettings(&settings, waves[w].type, features[f].apply);
+
+			if(Wanted("synth", name))
+				BenchSynth(name, &settings, sfxr_Supersampled);
+			if(Wanted("synth_bandlimited", name))
+				BenchSynth(name, &settings, sfxr_BandLimited);
+		}
+	}
+
+	if(Wanted("synth_multi", "mixed_16_voices"))		BenchMulti();
+	if(Wanted("compute_remaining", "randomize"))		BenchRemaining("randomize", sfxr_ComputeRemainingSamples);
+#if SFXR_UNIT_TESTS
+// the per sample loop the solver replaced, for comparison
+	if(Wanted("compute_remaining", "randomize_stepped"))	BenchRemaining("randomize_stepped", sfxr_ComputeRemainingSamplesStepped);
+#endif
+
+	if(Wanted("downsample", "44100_to_22050"))			BenchDownsample(22050);
+	if(Wanted("downsample", "44100_to_48000"))			BenchDownsample(48000);
+
+	if(Wanted("quantize", "u8"))						BenchQuantize("u8", sfxr_U8, 0);
+	if(Wanted("quantize", "s16"))						BenchQuantize("s16", sfxr_S16, 0);
+	if(Wanted("quantize", "s16_dither"))				BenchQuantize("s16_dither", sfxr_S16, 1);
+	if(Wanted("quantize", "s24"))						BenchQuantize("s24", sfxr_S24, 0);
+	if(Wanted("quantize", "f32"))						BenchQuantize("f32", sfxr_F32, 0);
+
+	if(Wanted("export_wav", "16_bit_44100"))			BenchExport("sfxr_bench.wav", 16, 44100);
+	if(Wanted("export_wav", "16_bit_22050"))			BenchExport("sfxr_bench.wav", 16, 22050);
+	if(Wanted("export_wav", "32_bit_48000"))			BenchExport("sfxr_bench.wav", 32, 48000);
+
+	return 0;
+}
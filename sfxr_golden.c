@@ -0,0 +1,794 @@
+// golden output regression test
+// renders a fixed corpus of settings (a few seeds of every preset plus edge cases) and checks:
+//   - the reference engine (sfxr_Supersampled, at 44100 and native rates) against stored hashes of its output,
+//	   both one voice at a time and through sfxr_DataSynthSampleMulti, which has to match it exactly.
+//   - the approximate modes (sfxr_BandLimited) against stored hashes of their output too, and against the
+//	   reference rendering of the same sound, within the signal to noise ratio and max error bounds[] has for the case.
+//   - the polynomial sine of the fast modes against libm (sfxr_UnitTestFastSin).
+//   - sfxr_ModelUpdate of one case into the next against sfxr_ModelInitRate of the next, at 44100, 22050 and 48000.
+//   - that a sequencer instrument set from a model keeps its wavetable.
+//   - sfxr_ComputeRemainingSamples against stepping every sample over a seeded set of sfxr_Randomize sounds.
+//
+// automated cases feed their breakpoints into a ring smaller than the script between blocks, so the curves
+// ramp, hold when the ring runs dry and wrap around it, the same way in both renderers.
+//
+// built with SFXR_COMPACT_VOICES every voice gets its own delay line attached, so the same golden file applies.
+//
+// hashes are of the float samples so they depend on the libm sin() and on the compiler not contracting to fma,
+// the cmake build turns contraction off.
+//
+// usage: sfxr_golden <golden file>			checks against the file, returns the number of failures
+//		  sfxr_golden --update <golden file>	writes the file from the current build
+
+#include "sfxr_soundeffects.h"
+#if !SFXR_UNIT_TESTS
+#error sfxr_golden needs the library built with SFXR_UNIT_TESTS
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+enum
+{
+	MAX_SAMPLES		= 44100 * 8,
+	BLOCK_LENGTH	= 4096,
+	SEEDS			= 4,
+	MAX_CASES		= 128,
+	NAME_LENGTH		= 48,
+	RING_LENGTH		= 4,
+	REMAINING_SOUNDS = 4000,
+	REMAINING_SEED	= 1
+};
+
+// bounds of every band limited case against the reference, fixed here rather than written by --update so a
+// regression can't creep in through it. each is what the case measured when it was added with a little slack.
+// the output is clamped to +-1, a band limited edge is a ramp where the reference steps so a full scale edge
+// costs up to about 1.5 on the sample it lands on, 2 (anything goes) means an edge a whole sample off.
+// noise is a different random sequence in the band limited mode, there's nothing to compare and no bounds.
+typedef struct Bounds
+{
+	const char * name;
+	double min_snr_db;
+	double max_error;
+} Bounds;
+
+static const Bounds bounds[] =
+{
+	{ "coin_0",               16.5, 1.54 },
+	{ "coin_1",               17.5, 0.89 },
+	{ "coin_2",               17.0, 1.02 },
+	{ "coin_3",               16.5, 0.89 },
+	{ "laser_0",              15.5, 1.37 },
+	{ "laser_1",              10.5, 0.86 },
+	{ "laser_2",              15.5, 1.15 },
+	{ "laser_3",              11.5, 0.93 },
+	{ "powerup_0",            22.5, 1.35 },
+	{ "powerup_1",            18.5, 0.95 },
+	{ "powerup_2",            24.5, 1.45 },
+	{ "powerup_3",            20.5, 1.02 },
+	{ "hit_0",                29.5, 0.95 },
+	{ "hit_1",                19.5, 0.94 },
+	{ "hit_2",                22.5, 0.73 },
+	{ "hit_3",                16.5, 0.84 },
+	{ "jump_0",               14.5, 1.02 },
+	{ "jump_1",               19.5, 0.96 },
+	{ "jump_2",               15.5, 1.00 },
+	{ "jump_3",               17.0, 0.66 },
+	{ "blip_0",               15.0, 1.14 },
+	{ "blip_1",               19.5, 0.96 },
+	{ "blip_2",               16.0, 1.47 },
+	{ "blip_3",               17.0, 0.91 },
+	{ "random_0",             10.0, 2.00 }, // 96% resonance rings into the clip
+	{ "random_1",             18.5, 0.06 },
+	{ "random_2",             16.0, 1.28 },
+	{ "random_3",              8.5, 0.04 }, // the high pass leaves a 0.03 residue of the top octave, mostly the aliasing the band limited mode removes
+	{ "square",               19.0, 0.90 },
+	{ "sawtooth",             18.5, 1.48 },
+	{ "sine",                 29.0, 0.08 },
+	{ "max_resonance",         4.5, 2.00 }, // 100% resonance rings on every edge and a ramp excites it differently than a step
+	{ "lowpass_sweep",        14.5, 1.39 },
+	{ "highpass_sweep",       18.5, 1.48 },
+	{ "retrigger",            19.5, 0.90 },
+	{ "arpeggio",             18.5, 0.90 },
+	{ "arpeggio_down",        18.5, 1.48 },
+	{ "vibrato",              27.0, 0.13 },
+	{ "phaser_sweep",         17.5, 1.02 },
+	{ "slide_to_limit",       21.0, 0.90 },
+	{ "punch",                17.0, 2.00 }, // punch drives the square into the clip, the ramp of an edge spans the full 2
+	{ "very_low",             33.0, 0.90 },
+	{ "very_high",             3.0, 0.90 }, // a 12 kHz square, the supersampled reference aliases and the band limited one doesn't
+	{ "blip_short",          100.0, 0.02 },
+	{ "nes_triangle",         29.5, 0.07 },
+	{ "nes_triangle_slide",   32.5, 0.10 },
+	{ "gameboy_wave",         25.0, 0.23 },
+	{ "table_missing",       100.0, 0.02 },
+	{ "coin_0_22050",         13.5, 1.73 }, // punch drives the square into the clip and at 22050 the ramp of an edge is twice as long
+	{ "coin_0_48000",         17.5, 1.51 },
+	{ "laser_0_22050",        12.0, 1.46 },
+	{ "laser_0_48000",        16.0, 1.31 },
+	{ "powerup_0_22050",      18.5, 1.44 },
+	{ "powerup_0_48000",      24.5, 1.02 },
+	{ "hit_0_22050",          26.5, 0.80 },
+	{ "hit_0_48000",          32.5, 0.74 },
+	{ "jump_0_22050",         11.5, 1.02 },
+	{ "jump_0_48000",         15.0, 1.02 },
+	{ "blip_0_22050",         12.0, 1.32 },
+	{ "blip_0_48000",         15.5, 1.46 },
+	{ "random_0_22050",       19.0, 0.50 },
+	{ "random_0_48000",       10.0, 2.00 }, // 96% resonance rings into the clip
+	{ "auto_volume",          19.0, 0.90 },
+	{ "auto_pitch",           17.5, 1.47 },
+	{ "auto_lowpass",         23.5, 0.10 },
+	{ "auto_everything",      21.5, 0.06 },
+	{ "auto_ring_wrap",       17.0, 1.48 },
+	{ "auto_set_late",        18.0, 0.78 },
+	{ "auto_native_48000",    24.5, 0.11 },
+};
+
+static Bounds const* FindBounds(const char * name)
+{
+	for(unsigned i = 0; i < sizeof(bounds) / sizeof(bounds[0]); ++i)
+	{
+		if(strcmp(bounds[i].name, name) == 0)
+			return &bounds[i];
+	}
+
+	return NULL;
+}
+
+typedef int (*sfxr_Preset)(sfxr_Settings * dst);
+
+static const struct { const char * name; sfxr_Preset generate; } presets[] =
+{
+	{ "coin",		sfxr_Coin },
+	{ "laser",		sfxr_Laser },
+	{ "explosion",	sfxr_Explosion },
+	{ "powerup",	sfxr_Powerup },
+	{ "hit",		sfxr_Hit },
+	{ "jump",		sfxr_Jump },
+	{ "blip",		sfxr_Blip },
+	{ "random",		sfxr_Randomize },
+};
+
+// one automated target, starting at start then following the breakpoints
+typedef struct Track
+{
+	enum sfxr_AutomationTarget target;
+	float start;
+	int count;
+	sfxr_Breakpoint const* points;
+} Track;
+
+#define TRACK(target, start, points) { target, start, sizeof(points) / sizeof(points[0]), points }
+
+typedef struct Case
+{
+	char name[NAME_LENGTH];
+	sfxr_Settings settings;
+	int sample_rate;
+	sfxr_Wavetable const* wavetable;
+	Track const* tracks;
+	int track_count;
+	int set_late; // curves are set after the automation is attached to the voice
+} Case;
+
+// what an automated voice needs while it plays
+typedef struct Automated
+{
+	sfxr_Automation automation;
+	sfxr_Curve curves[sfxr_AutomateTargets];
+	sfxr_Breakpoint rings[sfxr_AutomateTargets][RING_LENGTH];
+	int fed[sfxr_AutomateTargets];
+} Automated;
+
+static Case cases[MAX_CASES];
+static int case_count;
+
+static sfxr_Wavetable nes_triangle, gameboy_wave;
+static float wavetable_arena[SFXR_WAVETABLE_MAX_LENGTH * 2];
+
+static float reference[MAX_SAMPLES];
+static float rendered[MAX_SAMPLES];
+static float multi[MAX_CASES][BLOCK_LENGTH];
+
+/*
+ * corpus
+ */
+
+static Case * AddCase(const char * name, int sample_rate)
+{
+	Case * c = &cases[case_count++];
+	snprintf(c->name, sizeof(c->name), "%s", name);
+	c->sample_rate = sample_rate;
+	return c;
+}
+
+// a plain note to build the edge cases from
+static void Note(sfxr_Settings * s, enum sfxr_WaveType wave)
+{
+	sfxr_Init(s);
+	s->wave_type = wave;
+	s->envelope.sustainSec = 0.3f;
+	s->envelope.decaySec = 0.2f;
+	s->frequency.baseHz = 440;
+}
+
+// the 32 step triangle of the nes and a 4 bit wave channel pattern, both held at their native steps
+static void BuildWavetables(void)
+{
+	static const unsigned char pattern[32] = { 0,2,5,9,12,14,15,15,14,11,8,6,5,5,6,8,10,12,13,13,12,10,7,4,2,1,1,2,3,3,2,1 };
+	float triangle[32], wave[32];
+
+	for(int i = 0; i < 32; ++i)
+	{
+		triangle[i] = ((i < 16? 15 - i : i - 16) - 7.5f) / 7.5f;
+		wave[i] = (pattern[i] - 7.5f) / 7.5f;
+	}
+
+	int used = sfxr_WavetableInit(&nes_triangle, wavetable_arena, SFXR_WAVETABLE_MAX_LENGTH * 2, triangle, 32, 2048);
+	sfxr_WavetableInit(&gameboy_wave, wavetable_arena + used, SFXR_WAVETABLE_MAX_LENGTH * 2 - used, wave, 32, 512);
+}
+
+// breakpoints for the automated cases
+static const sfxr_Breakpoint volume_points[] = { { 0, 8000 }, { 1, 4000 }, { 0.5f, 0 }, { 1, 6000 } };
+static const sfxr_Breakpoint pitch_points[] = { { 2, 10000 }, { 0.5f, 8000 }, { 1, 0 } };
+static const sfxr_Breakpoint lowpass_points[] = { { 3000, 15000 } };
+static const sfxr_Breakpoint highpass_points[] = { { 2000, 12000 }, { 100, 6000 } };
+static const sfxr_Breakpoint duty_points[] = { { 10, 20000 } };
+static const sfxr_Breakpoint flanger_points[] = { { 5, 10000 }, { 1, 10000 } };
+static sfxr_Breakpoint wrap_points[24];
+
+static const Track volume_tracks[] = { TRACK(sfxr_AutomateVolume, 1, volume_points) };
+static const Track pitch_tracks[] = { TRACK(sfxr_AutomatePitch, 1, pitch_points) };
+static const Track lowpass_tracks[] = { TRACK(sfxr_AutomateLowPass, 300, lowpass_points) };
+static const Track everything_tracks[] =
+{
+	TRACK(sfxr_AutomateVolume, 1, volume_points),
+	TRACK(sfxr_AutomatePitch, 1, pitch_points),
+	TRACK(sfxr_AutomateLowPass, 300, lowpass_points),
+	TRACK(sfxr_AutomateHighPass, 100, highpass_points),
+	TRACK(sfxr_AutomateDuty, 50, duty_points),
+	TRACK(sfxr_AutomateFlanger, 0, flanger_points),
+};
+static const Track wrap_tracks[] = { TRACK(sfxr_AutomatePitch, 1, wrap_points) };
+static const sfxr_Breakpoint hold_points[] = { { 1.5f, 0 } };
+static const Track late_tracks[] = { TRACK(sfxr_AutomateVolume, 1, volume_points), TRACK(sfxr_AutomatePitch, 1.5f, hold_points) };
+
+static void Automate(Case * c, Track const* tracks, int count)
+{
+	c->tracks = tracks;
+	c->track_count = count;
+}
+
+#define AUTOMATE(c, tracks) Automate(c, tracks, sizeof(tracks) / sizeof(tracks[0]))
+
+static void BuildAutomatedCases(void)
+{
+	Case * c;
+
+// many more breakpoints than fit in the ring, a few go by every block
+	for(int i = 0; i < 24; ++i)
+	{
+		wrap_points[i].value = i % 2? 1.5f : 1.0f;
+		wrap_points[i].samples = 900;
+	}
+
+	c = AddCase("auto_volume", 44100);			Note(&c->settings, sfxr_Square);	AUTOMATE(c, volume_tracks);
+	c = AddCase("auto_pitch", 44100);			Note(&c->settings, sfxr_Sawtooth);	AUTOMATE(c, pitch_tracks);
+// the model's low pass is off, the curve has to turn it on
+	c = AddCase("auto_lowpass", 44100);			Note(&c->settings, sfxr_Square);	AUTOMATE(c, lowpass_tracks);
+	c = AddCase("auto_everything", 44100);		Note(&c->settings, sfxr_Square);	AUTOMATE(c, everything_tracks);
+	c = AddCase("auto_ring_wrap", 44100);		Note(&c->settings, sfxr_Sawtooth);	AUTOMATE(c, wrap_tracks);
+	c = AddCase("auto_set_late", 44100);		Note(&c->settings, sfxr_Square);	AUTOMATE(c, late_tracks);
+	c->set_late = 1;
+	c = AddCase("auto_native_48000", 48000);	Note(&c->settings, sfxr_Sawtooth);	AUTOMATE(c, everything_tracks);
+}
+
+static void BuildCorpus(void)
+{
+	char name[NAME_LENGTH];
+	Case * c;
+	sfxr_Settings * s;
+
+	for(unsigned p = 0; p < sizeof(presets) / sizeof(presets[0]); ++p)
+	{
+		for(int seed = 0; seed < SEEDS; ++seed)
+		{
+			snprintf(name, sizeof(name), "%s_%d", presets[p].name, seed);
+			sfxr_Seed(seed + 1);
+			presets[p].generate(&AddCase(name, 44100)->settings);
+		}
+	}
+
+	s = &AddCase("square", 44100)->settings;			Note(s, sfxr_Square);
+	s = &AddCase("sawtooth", 44100)->settings;			Note(s, sfxr_Sawtooth);
+	s = &AddCase("sine", 44100)->settings;				Note(s, sfxr_Sine);
+	s = &AddCase("noise", 44100)->settings;				Note(s, sfxr_Noise);
+	s = &AddCase("noise_low", 44100)->settings;			Note(s, sfxr_Noise); s->frequency.baseHz = 30;
+
+	s = &AddCase("max_resonance", 44100)->settings;		Note(s, sfxr_Sawtooth);
+	s->lowPassFilter.cutoffFrequencyHz = 800; s->lowPassFilter.resonancePercent = 100;
+	s = &AddCase("lowpass_sweep", 44100)->settings;		Note(s, sfxr_Square);
+	s->lowPassFilter.cutoffFrequencyHz = 300; s->lowPassFilter.cuttofSweep_sec = 4;
+	s = &AddCase("highpass_sweep", 44100)->settings;	Note(s, sfxr_Sawtooth);
+	s->highPassFilter.cutoffFrequencyHz = 200; s->highPassFilter.cuttofSweep_sec = 2;
+
+	s = &AddCase("retrigger", 44100)->settings;			Note(s, sfxr_Square);
+	s->retrigger.rateHz = 12; s->frequency.slideOctaves_s = -4; s->duty.sweepPercent_sec = 50;
+	s = &AddCase("arpeggio", 44100)->settings;			Note(s, sfxr_Square);
+	s->arpeggiation.frequencySemitones = 12; s->arpeggiation.speedSec = 0.1f;
+	s = &AddCase("arpeggio_down", 44100)->settings;		Note(s, sfxr_Sawtooth);
+	s->arpeggiation.frequencySemitones = -7; s->arpeggiation.speedSec = 0.05f; s->retrigger.rateHz = 4;
+	s = &AddCase("vibrato", 44100)->settings;			Note(s, sfxr_Sine);
+	s->vibrato.strengthPercent = 50; s->vibrato.speedHz = 8;
+	s = &AddCase("phaser_sweep", 44100)->settings;		Note(s, sfxr_Sawtooth);
+	s->flanger.offsetMs_sec = 10; s->flanger.sweepMs_sec2 = -5;
+	s = &AddCase("slide_to_limit", 44100)->settings;	Note(s, sfxr_Square);
+	s->frequency.slideOctaves_s = -8; s->frequency.limitHz = 100;
+	s = &AddCase("punch", 44100)->settings;				Note(s, sfxr_Square);
+	s->envelope.punchPercent = 100; s->envelope.attackSec = 0.05f;
+	s = &AddCase("very_low", 44100)->settings;			Note(s, sfxr_Square); s->frequency.baseHz = 20;
+	s = &AddCase("very_high", 44100)->settings;			Note(s, sfxr_Square); s->frequency.baseHz = 12000;
+	s = &AddCase("blip_short", 44100)->settings;		Note(s, sfxr_Square);
+	s->envelope.sustainSec = 0; s->envelope.decaySec = 0.001f;
+
+	BuildWavetables();
+	c = AddCase("nes_triangle", 44100);					Note(&c->settings, sfxr_Table);
+	c->wavetable = &nes_triangle;
+	c = AddCase("nes_triangle_slide", 44100);			Note(&c->settings, sfxr_Table);
+	c->wavetable = &nes_triangle; c->settings.frequency.baseHz = 110; c->settings.frequency.slideOctaves_s = 6;
+	c = AddCase("gameboy_wave", 44100);					Note(&c->settings, sfxr_Table);
+	c->wavetable = &gameboy_wave; c->settings.frequency.baseHz = 220; c->settings.vibrato.strengthPercent = 20;
+	c = AddCase("table_missing", 44100);				Note(&c->settings, sfxr_Table);
+
+// the same sounds synthesized natively at other rates
+	for(unsigned p = 0; p < sizeof(presets) / sizeof(presets[0]); ++p)
+	{
+		for(int r = 0; r < 2; ++r)
+		{
+			int rate = r? 48000 : 22050;
+			snprintf(name, sizeof(name), "%s_0_%d", presets[p].name, rate);
+			AddCase(name, rate)->settings = cases[p * SEEDS].settings;
+		}
+	}
+
+	BuildAutomatedCases();
+}
+
+/*
+ * rendering
+ */
+
+static void InitModel(sfxr_Model * model, Case const* c, enum sfxr_Oscillator oscillator)
+{
+	if(c->sample_rate == 44100)
+		sfxr_ModelInit(model, &c->settings);
+	else
+		sfxr_ModelInitRate(model, &c->settings, c->sample_rate);
+
+	model->oscillator = oscillator;
+	sfxr_ModelSetWavetable(model, c->wavetable);
+}
+
+static void Attach(Automated * a, Case const* c, sfxr_Data * data)
+{
+	if(c->track_count == 0) return;
+
+	sfxr_AutomationInit(&a->automation);
+	if(c->set_late)
+		sfxr_DataAutomate(data, &a->automation);
+
+	for(int t = 0; t < c->track_count; ++t)
+	{
+		sfxr_CurveInit(&a->curves[t], a->rings[t], RING_LENGTH, c->tracks[t].start);
+		sfxr_AutomationSet(&a->automation, c->tracks[t].target, &a->curves[t]);
+		a->fed[t] = 0;
+	}
+
+	if(!c->set_late)
+		sfxr_DataAutomate(data, &a->automation);
+}
+
+// tops up the rings, called before every block
+static void Feed(Automated * a, Case const* c)
+{
+	for(int t = 0; t < c->track_count; ++t)
+	{
+		Track const* track = &c->tracks[t];
+		while(a->fed[t] < track->count
+		&& sfxr_CurvePush(&a->curves[t], track->points[a->fed[t]].value, track->points[a->fed[t]].samples) == 0)
+			++a->fed[t];
+	}
+}
+
+// renders model with the automation of c
+static int RenderModel(sfxr_Model const* model, Case const* c, float * dst)
+{
+	sfxr_Data data;
+	Automated automated;
+	int length = 0, written;
+
+	sfxr_DataInit(&data, model);
+	Attach(&automated, c, &data);
+#if SFXR_COMPACT_VOICES
+	static float phaser[SFXR_PHASER_LENGTH];
+	sfxr_DataSetPhaser(&data, phaser);
+#endif
+
+	while(length < MAX_SAMPLES)
+	{
+		Feed(&automated, c);
+		if((written = sfxr_DataSynthSample(&data,
+			MAX_SAMPLES - length < BLOCK_LENGTH? MAX_SAMPLES - length : BLOCK_LENGTH, dst + length)) <= 0)
+			break;
+		length += written;
+	}
+
+	return length;
+}
+
+static int Render(Case const* c, enum sfxr_Oscillator oscillator, float * dst)
+{
+	sfxr_Model model;
+	InitModel(&model, c, oscillator);
+	return RenderModel(&model, c, dst);
+}
+
+// sfxr_ModelUpdate with what sfxr_SettingsDiff says changed has to render the same as sfxr_ModelInit, at any rate.
+// every plain case is updated into the next one
+static int CheckModelUpdate(void)
+{
+	static const int rates[] = { 44100, 22050, 48000 };
+	int failures = 0;
+
+	for(unsigned r = 0; r < sizeof(rates) / sizeof(rates[0]); ++r)
+	{
+		for(int i = 0; i < case_count; ++i)
+		{
+			Case const* from = &cases[i];
+			Case const* to = &cases[(i + 1) % case_count];
+			if(from->sample_rate != 44100 || to->sample_rate != 44100 || to->track_count != 0) continue;
+
+			sfxr_Model updated, expected;
+			sfxr_ModelInitRate(&updated, &from->settings, rates[r]);
+			sfxr_ModelUpdate(&updated, &to->settings, sfxr_SettingsDiff(&from->settings, &to->settings));
+			sfxr_ModelInitRate(&expected, &to->settings, rates[r]);
+			sfxr_ModelSetWavetable(&updated, to->wavetable);
+			sfxr_ModelSetWavetable(&expected, to->wavetable);
+
+			int length = RenderModel(&expected, to, reference);
+			if(RenderModel(&updated, to, rendered) != length || memcmp(reference, rendered, length * sizeof(float)) != 0)
+			{
+				printf("FAIL model update %s to %s at %d: differs from sfxr_ModelInitRate\n", from->name, to->name, rates[r]);
+				++failures;
+			}
+		}
+	}
+
+	return failures;
+}
+
+// a sequencer instrument set from settings can't have a table, one set from a model keeps it
+static int CheckSequencerTable(void)
+{
+	static sfxr_Sequencer sequencer;
+	sfxr_Settings settings;
+	sfxr_Model model;
+	sfxr_Event note = { 0, 0, 0, 69, 100 };
+	int failures = 0;
+
+	Note(&settings, sfxr_Table);
+	sfxr_ModelInitRate(&model, &settings, 22050);
+	sfxr_ModelSetWavetable(&model, &nes_triangle);
+
+	sfxr_SequencerInit(&sequencer, 44100, 100);
+	if(sfxr_SequencerSetInstrumentModel(&sequencer, 0, &model) == 0)
+	{
+		printf("FAIL sequencer table: took a model at a different sample rate\n");
+		++failures;
+	}
+
+	sfxr_ModelInitRate(&model, &settings, 44100);
+	sfxr_ModelSetWavetable(&model, &nes_triangle);
+	sfxr_SequencerSetInstrumentModel(&sequencer, 0, &model);
+	sfxr_SequencerRender(&sequencer, reference, BLOCK_LENGTH, &note, 1, NULL);
+
+	float peak = 0;
+	for(int i = 0; i < BLOCK_LENGTH * 2; ++i)
+		peak = fabsf(reference[i]) > peak? fabsf(reference[i]) : peak;
+
+	if(peak < 0.01f)
+	{
+		printf("FAIL sequencer table: sfxr_SequencerSetInstrumentModel played silence\n");
+		++failures;
+	}
+
+	return failures;
+}
+
+// sfxr_ComputeRemainingSamples solves where the slide crosses the limit, it has to land on the sample stepping finds
+static int CheckRemainingSamples(void)
+{
+	sfxr_Settings settings;
+	sfxr_Model model;
+	sfxr_Data data;
+	int failures = 0;
+
+	sfxr_Seed(REMAINING_SEED);
+	for(int i = 0; i < REMAINING_SOUNDS; ++i)
+	{
+		sfxr_Randomize(&settings);
+		sfxr_ModelInit(&model, &settings);
+		sfxr_DataInit(&data, &model);
+
+		int solved = sfxr_ComputeRemainingSamples(&data);
+		int stepped = sfxr_ComputeRemainingSamplesStepped(&data);
+		if(solved != stepped)
+		{
+			if(failures < 10)
+				printf("FAIL remaining samples: sfxr_Randomize sound %d solves to %d, stepping gives %d\n", i, solved, stepped);
+			++failures;
+		}
+	}
+
+	return failures;
+}
+
+#define HASH_START 14695981039346656037ULL
+
+// fnv-1a over the bits of the samples, continuing from hash
+static unsigned long long Hash(unsigned long long hash, float const* samples, int length)
+{
+	unsigned char const* bytes = (unsigned char const*)samples;
+
+	for(size_t i = 0; i < length * sizeof(float); ++i)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+
+	return hash;
+}
+
+static void Compare(float const* expected, float const* actual, int length, double * snr_db, double * max_error)
+{
+	double signal = 0, noise = 0;
+	*max_error = 0;
+
+	for(int i = 0; i < length; ++i)
+	{
+		double error = fabs((double)actual[i] - expected[i]);
+		signal += (double)expected[i] * expected[i];
+		noise += error * error;
+		if(error > *max_error) *max_error = error;
+	}
+
+	*snr_db = noise == 0? 999 : signal == 0? -999 : 10 * log10(signal / noise);
+}
+
+/*
+ * golden file, one line per check:
+ *   exact <case> <samples> <hash>
+ *   bandlimited <case> <samples> <hash>
+ */
+
+typedef struct Golden
+{
+	char mode[16];
+	char name[NAME_LENGTH];
+	int samples;
+	unsigned long long hash;
+} Golden;
+
+static Golden golden[MAX_CASES * 2];
+static int golden_count;
+
+static int ReadGolden(const char * filename)
+{
+	FILE * file = fopen(filename, "r");
+	if(!file) return -1;
+
+	char line[256];
+	while(fgets(line, sizeof(line), file) && golden_count < MAX_CASES * 2)
+	{
+		Golden * g = &golden[golden_count];
+		if(line[0] == '#') continue;
+
+		if(sscanf(line, "exact %47s %d %llx", g->name, &g->samples, &g->hash) == 3)
+			strcpy(g->mode, "exact");
+		else if(sscanf(line, "bandlimited %47s %d %llx", g->name, &g->samples, &g->hash) == 3)
+			strcpy(g->mode, "bandlimited");
+		else
+			continue;
+
+		++golden_count;
+	}
+
+	fclose(file);
+	return golden_count;
+}
+
+static Golden const* FindGolden(const char * mode, const char * name)
+{
+	for(int i = 0; i < golden_count; ++i)
+	{
+		if(strcmp(golden[i].mode, mode) == 0 && strcmp(golden[i].name, name) == 0)
+			return &golden[i];
+	}
+
+	return NULL;
+}
+
+// writes the hash with --update, otherwise checks it against the golden file
+static int CheckHash(FILE * out, const char * filename, const char * mode, const char * name, int length, unsigned long long hash)
+{
+	if(out)
+	{
+		fprintf(out, "%s %s %d %016llx\n", mode, name, length, hash);
+		return 0;
+	}
+
+	Golden const* g = FindGolden(mode, name);
+	if(!g)
+	{
+		printf("FAIL %s %s: not in %s\n", mode, name, filename);
+		return 1;
+	}
+
+	if(g->samples != length || g->hash != hash)
+	{
+		printf("FAIL %s %s: %d samples hash %016llx, expected %d samples hash %016llx\n",
+			mode, name, length, hash, g->samples, g->hash);
+		return 1;
+	}
+
+	return 0;
+}
+
+int main(int argc, char ** argv)
+{
+	int update = argc > 2 && strcmp(argv[1], "--update") == 0;
+	const char * filename = argv[argc-1];
+
+	if(argc < 2 || (argc > 2 && !update))
+	{
+		fprintf(stderr, "usage: %s [--update] <golden file>\n", argv[0]);
+		return 1;
+	}
+
+	BuildCorpus();
+
+	FILE * out = NULL;
+	if(update)
+	{
+		if(!(out = fopen(filename, "w")))
+		{
+			fprintf(stderr, "can't write %s\n", filename);
+			return 1;
+		}
+
+		fprintf(out, "# written by sfxr_golden --update, see sfxr_golden.c\n");
+		fprintf(out, "# exact|bandlimited <case> <samples> <fnv-1a of the float samples>\n");
+	}
+	else if(ReadGolden(filename) < 0)
+	{
+		fprintf(stderr, "can't read %s\n", filename);
+		return 1;
+	}
+
+	int failures = 0;
+
+	if(sfxr_UnitTestFastSin(stdout) != 0)
+	{
+		printf("FAIL fast sin: out of bounds against libm\n");
+		++failures;
+	}
+
+	failures += CheckModelUpdate();
+	failures += CheckSequencerTable();
+	failures += CheckRemainingSamples();
+
+// every voice at once through the simd renderer a block at a time, it has to hash the same
+	static sfxr_Model models[MAX_CASES];
+	static sfxr_Data data[MAX_CASES];
+	static Automated automated[MAX_CASES];
+#if SFXR_COMPACT_VOICES
+	static float phasers[MAX_CASES][SFXR_PHASER_LENGTH];
+#endif
+	sfxr_Data * voices[MAX_CASES];
+	float * buffers[MAX_CASES];
+	int written[MAX_CASES];
+	int multi_length[MAX_CASES] = {0};
+	unsigned long long multi_hash[MAX_CASES];
+
+	for(int i = 0; i < case_count; ++i)
+	{
+		InitModel(&models[i], &cases[i], sfxr_Supersampled);
+		sfxr_DataInit(&data[i], &models[i]);
+		Attach(&automated[i], &cases[i], &data[i]);
+#if SFXR_COMPACT_VOICES
+		sfxr_DataSetPhaser(&data[i], phasers[i]);
+#endif
+		voices[i] = &data[i];
+		buffers[i] = multi[i];
+		multi_hash[i] = HASH_START;
+	}
+
+	for(int done = 0; done < MAX_SAMPLES; done += BLOCK_LENGTH)
+	{
+		for(int i = 0; i < case_count; ++i)
+			Feed(&automated[i], &cases[i]);
+
+		sfxr_DataSynthSampleMulti(voices, case_count, BLOCK_LENGTH, buffers, written);
+
+		for(int i = 0; i < case_count; ++i)
+		{
+			multi_hash[i] = Hash(multi_hash[i], multi[i], written[i]);
+			multi_length[i] += written[i];
+		}
+	}
+
+	for(int i = 0; i < case_count; ++i)
+	{
+		Case const* c = &cases[i];
+		int length = Render(c, sfxr_Supersampled, reference);
+		unsigned long long hash = Hash(HASH_START, reference, length);
+
+		if(multi_length[i] != length || multi_hash[i] != hash)
+		{
+			printf("FAIL multi %s: sfxr_DataSynthSampleMulti differs from sfxr_DataSynthSample\n", c->name);
+			++failures;
+		}
+
+		failures += CheckHash(out, filename, "exact", c->name, length, hash);
+
+		int fast_length = Render(c, sfxr_BandLimited, rendered);
+		failures += CheckHash(out, filename, "bandlimited", c->name, fast_length, Hash(HASH_START, rendered, fast_length));
+
+		if(c->settings.wave_type == sfxr_Noise)
+			continue;
+
+		Bounds const* bound = FindBounds(c->name);
+		if(!bound)
+		{
+			printf("FAIL bandlimited %s: no bounds\n", c->name);
+			++failures;
+			continue;
+		}
+
+		double snr_db, max_error;
+		Compare(reference, rendered, length < fast_length? length : fast_length, &snr_db, &max_error);
+
+		if(fast_length != length || snr_db < bound->min_snr_db || max_error > bound->max_error)
+		{
+			printf("FAIL bandlimited %s: %d samples snr %.2f db max error %.4f, expected %d samples snr >= %.2f db max error <= %.4f\n",
+				c->name, fast_length, snr_db, max_error, length, bound->min_snr_db, bound->max_error);
+			++failures;
+		}
+	}
+
+// stale bounds would quietly apply to whatever case takes their name next
+	for(unsigned i = 0; i < sizeof(bounds) / sizeof(bounds[0]); ++i)
+	{
+		int found = 0;
+		for(int j = 0; j < case_count && !found; ++j)
+			found = strcmp(cases[j].name, bounds[i].name) == 0;
+
+		if(!found)
+		{
+			printf("FAIL bounds %s: no such case\n", bounds[i].name);
+			++failures;
+		}
+	}
+
+	if(out)
+	{
+		fclose(out);
+		printf("{\"cases\": %d, \"written\": \"%s\"}\n", case_count, filename);
+		return failures != 0;
+	}
+
+	printf("{\"cases\": %d, \"failures\": %d}\n", case_count, failures);
+	return failures != 0;
+}
@@ -0,0 +1,96 @@
+// command line front end for sfxr_ExportMidi
+// renders a type 0 or 1 midi file to a stereo wav, every midi channel plays a preset sound as its instrument
+// (channel 10, drums, gets sfxr_Hit)
+//
+// usage: sfxr_midi <input .mid> <output .wav> [wav bits] [sample rate] [seed]
+
+#include "sfxr_soundeffects.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+typedef int (*sfxr_Preset)(sfxr_Settings * dst);
+
+static const sfxr_Preset melodic[] = { sfxr_Blip, sfxr_Powerup, sfxr_Coin, sfxr_Laser };
+
+enum
+{
+	MELODIC_COUNT = sizeof(melodic) / sizeof(melodic[0]),
+	DRUM_CHANNEL = 9
+};
+
+static sfxr_Sequencer sequencer;
+
+int main(int argc, char ** argv)
+{
+	if(argc < 3)
+	{
+		fprintf(stderr, "usage: %s <input .mid> <output .wav> [wav bits] [sample rate] [seed]\n", argv[0]);
+		return 1;
+	}
+
+	int wav_bits	= argc > 3? atoi(argv[3]) : 16;
+	int sample_rate = argc > 4? atoi(argv[4]) : 44100;
+	unsigned int seed = argc > 5? (unsigned int)strtoul(argv[5], NULL, 10) : 1;
+
+	FILE * file = fopen(argv[1], "rb");
+	if(!file)
+	{
+		fprintf(stderr, "can't open %s\n", argv[1]);
+		return 1;
+	}
+
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	unsigned char * data = size > 0? malloc(size) : NULL;
+	if(!data || fread(data, 1, size, file) != (size_t)size)
+	{
+		fprintf(stderr, "can't read %s\n", argv[1]);
+		return 1;
+	}
+
+	fclose(file);
+
+	if(sfxr_SequencerInit(&sequencer, sample_rate, 1) < 0)
+	{
+		fprintf(stderr, "bad sample rate %d\n", sample_rate);
+		return 1;
+	}
+
+	sfxr_Seed(seed);
+	for(int c = 0; c < SFXR_SEQUENCER_CHANNELS; ++c)
+	{
+		sfxr_Settings settings;
+		if(c == DRUM_CHANNEL)
+			sfxr_Hit(&settings);
+		else
+			melodic[c % MELODIC_COUNT](&settings);
+
+		sfxr_SequencerSetInstrument(&sequencer, c, &settings);
+// quieter than 1 so chords don't clip, spread across the stereo field
+		sfxr_SequencerSetChannel(&sequencer, c, 0.25f, (c % 5 - 2) * 0.25f);
+	}
+
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	int frames = sfxr_ExportMidi(&sequencer, data, size, wav_bits, argv[2]);
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+
+	free(data);
+
+	if(frames < 0)
+	{
+		fprintf(stderr, "failed to render %s\n", argv[1]);
+		return 1;
+	}
+
+	printf("{\"frames\": %d, \"notes\": %llu, \"steals\": %llu, \"seconds\": %f, \"realtime\": %f}\n",
+		frames, sequencer.notes, sequencer.steals, seconds, frames / (double)sample_rate / seconds);
+
+	return 0;
+}
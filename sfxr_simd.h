@@ -0,0 +1,241 @@
+// thin wrapper over the SSE2/AVX2/AVX-512 intrinsics used by the multi voice renderer
+// not part of the public api, only included by the library sources.
+//
+// every operation maps onto exactly one IEEE single precision instruction
+// so that a lane computes the same bits as the scalar code does.
+// vf_min(a, b) is a < b? a : b and vf_max(a, b) is a > b? a : b, so NaNs in b pass through
+// the way they do for if(b > a) b = a; in the scalar code.
+// vf_hsum is the exception, it sums the lanes in whatever order is cheapest,
+// only use it where the result doesn't need to match scalar code.
+// vf_to_vi rounds to nearest even, vi_store16/vi_store8 narrow with signed/unsigned saturation
+// and don't need p aligned.
+
+#ifndef SFXR_SIMD_H
+#define SFXR_SIMD_H
+#include <stdint.h>
+
+#if defined(__AVX512F__)
+#include <immintrin.h>
+#define SFXR_SIMD_WIDTH 16
+#define SFXR_SIMD_SHIFT 4
+#elif defined(__AVX2__)
+#include <immintrin.h>
+#define SFXR_SIMD_WIDTH 8
+#define SFXR_SIMD_SHIFT 3
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SFXR_SIMD_WIDTH 4
+#define SFXR_SIMD_SHIFT 2
+#else
+// plain loops the compiler is free to vectorize on its own
+#define SFXR_SIMD_WIDTH 4
+#define SFXR_SIMD_SHIFT 2
+#define SFXR_SIMD_SCALAR 1
+#endif
+
+#if defined(_MSC_VER)
+#define SFXR_ALIGNED __declspec(align(64))
+#else
+#define SFXR_ALIGNED __attribute__((aligned(64)))
+#endif
+
+#if defined(__AVX512F__)
+
+typedef __m512  vf;
+typedef __m512i vi;
+typedef __mmask16 vmask;
+
+static inline vf vf_load(float const* p)			{ return _mm512_load_ps(p); }
+static inline vf vf_loadu(float const* p)			{ return _mm512_loadu_ps(p); }
+static inline void vf_store(float * p, vf a)		{ _mm512_store_ps(p, a); }
+static inline void vf_storeu(float * p, vf a)		{ _mm512_storeu_ps(p, a); }
+static inline vf vf_set1(float a)					{ return _mm512_set1_ps(a); }
+static inline vf vf_add(vf a, vf b)					{ return _mm512_add_ps(a, b); }
+static inline vf vf_sub(vf a, vf b)					{ return _mm512_sub_ps(a, b); }
+static inline vf vf_mul(vf a, vf b)					{ return _mm512_mul_ps(a, b); }
+static inline vf vf_div(vf a, vf b)					{ return _mm512_div_ps(a, b); }
+static inline vf vf_min(vf a, vf b)					{ return _mm512_min_ps(a, b); }
+static inline vf vf_max(vf a, vf b)					{ return _mm512_max_ps(a, b); }
+static inline vmask vf_lt(vf a, vf b)				{ return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+static inline vmask vf_gt(vf a, vf b)				{ return _mm512_cmp_ps_mask(a, b, _CMP_GT_OQ); }
+// mask? a : b
+static inline vf vf_select(vmask m, vf a, vf b)		{ return _mm512_mask_blend_ps(m, b, a); }
+
+static inline vi vi_load(int32_t const* p)			{ return _mm512_load_si512((void const*)p); }
+static inline void vi_store(int32_t * p, vi a)		{ _mm512_store_si512((void*)p, a); }
+static inline vi vi_set1(int32_t a)					{ return _mm512_set1_epi32(a); }
+static inline vi vi_add(vi a, vi b)					{ return _mm512_add_epi32(a, b); }
+static inline vi vi_sub(vi a, vi b)					{ return _mm512_sub_epi32(a, b); }
+static inline vi vi_and(vi a, vi b)					{ return _mm512_and_si512(a, b); }
+static inline vi vi_sll(vi a, int n)				{ return _mm512_slli_epi32(a, n); }
+static inline vi vi_srl(vi a, int n)				{ return _mm512_srli_epi32(a, n); }
+static inline vi vi_xor(vi a, vi b)					{ return _mm512_xor_si512(a, b); }
+static inline vmask vi_lt(vi a, vi b)				{ return _mm512_cmplt_epi32_mask(a, b); }
+static inline vmask vi_eq(vi a, vi b)				{ return _mm512_cmpeq_epi32_mask(a, b); }
+static inline vf vi_to_vf(vi a)						{ return _mm512_cvtepi32_ps(a); }
+static inline vi vf_to_vi(vf a)						{ return _mm512_cvtps_epi32(a); }
+static inline void vi_store16(int16_t * p, vi a)	{ _mm256_storeu_si256((__m256i*)p, _mm512_cvtsepi32_epi16(a)); }
+static inline void vi_store8(uint8_t * p, vi a)		{ _mm_storeu_si128((__m128i*)p, _mm512_cvtusepi32_epi8(_mm512_max_epi32(a, _mm512_setzero_si512()))); }
+static inline vf vf_gather(float const* p, vi i)	{ return _mm512_i32gather_ps(i, p, 4); }
+
+static inline int vmask_bits(vmask m)				{ return (int)m; }
+static inline float vf_hsum(vf a)					{ return _mm512_reduce_add_ps(a); }
+
+#elif defined(__AVX2__)
+
+typedef __m256  vf;
+typedef __m256i vi;
+typedef __m256  vmask;
+
+static inline vf vf_load(float const* p)			{ return _mm256_load_ps(p); }
+static inline vf vf_loadu(float const* p)			{ return _mm256_loadu_ps(p); }
+static inline void vf_store(float * p, vf a)		{ _mm256_store_ps(p, a); }
+static inline void vf_storeu(float * p, vf a)		{ _mm256_storeu_ps(p, a); }
+static inline vf vf_set1(float a)					{ return _mm256_set1_ps(a); }
+static inline vf vf_add(vf a, vf b)					{ return _mm256_add_ps(a, b); }
+static inline vf vf_sub(vf a, vf b)					{ return _mm256_sub_ps(a, b); }
+static inline vf vf_mul(vf a, vf b)					{ return _mm256_mul_ps(a, b); }
+static inline vf vf_div(vf a, vf b)					{ return _mm256_div_ps(a, b); }
+static inline vf vf_min(vf a, vf b)					{ return _mm256_min_ps(a, b); }
+static inline vf vf_max(vf a, vf b)					{ return _mm256_max_ps(a, b); }
+static inline vmask vf_lt(vf a, vf b)				{ return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+static inline vmask vf_gt(vf a, vf b)				{ return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+static inline vf vf_select(vmask m, vf a, vf b)		{ return _mm256_blendv_ps(b, a, m); }
+
+static inline vi vi_load(int32_t const* p)			{ return _mm256_load_si256((__m256i const*)p); }
+static inline void vi_store(int32_t * p, vi a)		{ _mm256_store_si256((__m256i*)p, a); }
+static inline vi vi_set1(int32_t a)					{ return _mm256_set1_epi32(a); }
+static inline vi vi_add(vi a, vi b)					{ return _mm256_add_epi32(a, b); }
+static inline vi vi_sub(vi a, vi b)					{ return _mm256_sub_epi32(a, b); }
+static inline vi vi_and(vi a, vi b)					{ return _mm256_and_si256(a, b); }
+static inline vi vi_sll(vi a, int n)				{ return _mm256_slli_epi32(a, n); }
+static inline vi vi_srl(vi a, int n)				{ return _mm256_srli_epi32(a, n); }
+static inline vi vi_xor(vi a, vi b)					{ return _mm256_xor_si256(a, b); }
+static inline vmask vi_lt(vi a, vi b)				{ return _mm256_castsi256_ps(_mm256_cmpgt_epi32(b, a)); }
+static inline vmask vi_eq(vi a, vi b)				{ return _mm256_castsi256_ps(_mm256_cmpeq_epi32(a, b)); }
+static inline vf vi_to_vf(vi a)						{ return _mm256_cvtepi32_ps(a); }
+static inline vi vf_to_vi(vf a)						{ return _mm256_cvtps_epi32(a); }
+static inline void vi_store16(int16_t * p, vi a)
+{
+	__m256i s = _mm256_permute4x64_epi64(_mm256_packs_epi32(a, a), 0xD8);
+	_mm_storeu_si128((__m128i*)p, _mm256_castsi256_si128(s));
+}
+static inline void vi_store8(uint8_t * p, vi a)
+{
+	__m128i s = _mm_packs_epi32(_mm256_castsi256_si128(a), _mm256_extracti128_si256(a, 1));
+	_mm_storel_epi64((__m128i*)p, _mm_packus_epi16(s, s));
+}
+static inline vf vf_gather(float const* p, vi i)	{ return _mm256_i32gather_ps(p, i, 4); }
+
+static inline int vmask_bits(vmask m)				{ return _mm256_movemask_ps(m); }
+
+static inline float vf_hsum(vf a)
+{
+	__m128 r = _mm_add_ps(_mm256_castps256_ps128(a), _mm256_extractf128_ps(a, 1));
+	r = _mm_add_ps(r, _mm_movehl_ps(r, r));
+	return _mm_cvtss_f32(_mm_add_ss(r, _mm_shuffle_ps(r, r, 1)));
+}
+
+#elif !defined(SFXR_SIMD_SCALAR)
+
+typedef __m128  vf;
+typedef __m128i vi;
+typedef __m128  vmask;
+
+static inline vf vf_load(float const* p)			{ return _mm_load_ps(p); }
+static inline vf vf_loadu(float const* p)			{ return _mm_loadu_ps(p); }
+static inline void vf_store(float * p, vf a)		{ _mm_store_ps(p, a); }
+static inline void vf_storeu(float * p, vf a)		{ _mm_storeu_ps(p, a); }
+static inline vf vf_set1(float a)					{ return _mm_set1_ps(a); }
+static inline vf vf_add(vf a, vf b)					{ return _mm_add_ps(a, b); }
+static inline vf vf_sub(vf a, vf b)					{ return _mm_sub_ps(a, b); }
+static inline vf vf_mul(vf a, vf b)					{ return _mm_mul_ps(a, b); }
+static inline vf vf_div(vf a, vf b)					{ return _mm_div_ps(a, b); }
+static inline vf vf_min(vf a, vf b)					{ return _mm_min_ps(a, b); }
+static inline vf vf_max(vf a, vf b)					{ return _mm_max_ps(a, b); }
+static inline vmask vf_lt(vf a, vf b)				{ return _mm_cmplt_ps(a, b); }
+static inline vmask vf_gt(vf a, vf b)				{ return _mm_cmpgt_ps(a, b); }
+static inline vf vf_select(vmask m, vf a, vf b)		{ return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+
+static inline vi vi_load(int32_t const* p)			{ return _mm_load_si128((__m128i const*)p); }
+static inline void vi_store(int32_t * p, vi a)		{ _mm_store_si128((__m128i*)p, a); }
+static inline vi vi_set1(int32_t a)					{ return _mm_set1_epi32(a); }
+static inline vi vi_add(vi a, vi b)					{ return _mm_add_epi32(a, b); }
+static inline vi vi_sub(vi a, vi b)					{ return _mm_sub_epi32(a, b); }
+static inline vi vi_and(vi a, vi b)					{ return _mm_and_si128(a, b); }
+static inline vi vi_sll(vi a, int n)				{ return _mm_slli_epi32(a, n); }
+static inline vi vi_srl(vi a, int n)				{ return _mm_srli_epi32(a, n); }
+static inline vi vi_xor(vi a, vi b)					{ return _mm_xor_si128(a, b); }
+static inline vmask vi_lt(vi a, vi b)				{ return _mm_castsi128_ps(_mm_cmplt_epi32(a, b)); }
+static inline vmask vi_eq(vi a, vi b)				{ return _mm_castsi128_ps(_mm_cmpeq_epi32(a, b)); }
+static inline vf vi_to_vf(vi a)						{ return _mm_cvtepi32_ps(a); }
+static inline vi vf_to_vi(vf a)						{ return _mm_cvtps_epi32(a); }
+static inline void vi_store16(int16_t * p, vi a)	{ _mm_storel_epi64((__m128i*)p, _mm_packs_epi32(a, a)); }
+static inline void vi_store8(uint8_t * p, vi a)
+{
+	__m128i s = _mm_packs_epi32(a, a);
+	*(int32_t*)p = _mm_cvtsi128_si32(_mm_packus_epi16(s, s));
+}
+static inline vf vf_gather(float const* p, vi i)
+{
+	return _mm_setr_ps(p[_mm_cvtsi128_si32(i)], p[_mm_cvtsi128_si32(_mm_shuffle_epi32(i, 1))],
+		p[_mm_cvtsi128_si32(_mm_shuffle_epi32(i, 2))], p[_mm_cvtsi128_si32(_mm_shuffle_epi32(i, 3))]);
+}
+
+static inline int vmask_bits(vmask m)				{ return _mm_movemask_ps(m); }
+
+static inline float vf_hsum(vf a)
+{
+	a = _mm_add_ps(a, _mm_movehl_ps(a, a));
+	return _mm_cvtss_f32(_mm_add_ss(a, _mm_shuffle_ps(a, a, 1)));
+}
+
+#else
+#include <math.h>
+
+typedef struct { float v[SFXR_SIMD_WIDTH]; } vf;
+typedef struct { int32_t v[SFXR_SIMD_WIDTH]; } vi;
+typedef int vmask;
+
+#define SFXR_LANES_(expr) for(int l = 0; l < SFXR_SIMD_WIDTH; ++l) { expr; }
+
+static inline vf vf_load(float const* p)			{ vf r; SFXR_LANES_(r.v[l] = p[l]) return r; }
+static inline vf vf_loadu(float const* p)			{ vf r; SFXR_LANES_(r.v[l] = p[l]) return r; }
+static inline void vf_store(float * p, vf a)		{ SFXR_LANES_(p[l] = a.v[l]) }
+static inline void vf_storeu(float * p, vf a)		{ SFXR_LANES_(p[l] = a.v[l]) }
+static inline vf vf_set1(float a)					{ vf r; SFXR_LANES_(r.v[l] = a) return r; }
+static inline vf vf_add(vf a, vf b)					{ SFXR_LANES_(a.v[l] = a.v[l] + b.v[l]) return a; }
+static inline vf vf_sub(vf a, vf b)					{ SFXR_LANES_(a.v[l] = a.v[l] - b.v[l]) return a; }
+static inline vf vf_mul(vf a, vf b)					{ SFXR_LANES_(a.v[l] = a.v[l] * b.v[l]) return a; }
+static inline vf vf_div(vf a, vf b)					{ SFXR_LANES_(a.v[l] = a.v[l] / b.v[l]) return a; }
+static inline vf vf_min(vf a, vf b)					{ SFXR_LANES_(a.v[l] = a.v[l] < b.v[l]? a.v[l] : b.v[l]) return a; }
+static inline vf vf_max(vf a, vf b)					{ SFXR_LANES_(a.v[l] = a.v[l] > b.v[l]? a.v[l] : b.v[l]) return a; }
+static inline vmask vf_lt(vf a, vf b)				{ vmask m = 0; SFXR_LANES_(m |= (a.v[l] < b.v[l]) << l) return m; }
+static inline vmask vf_gt(vf a, vf b)				{ vmask m = 0; SFXR_LANES_(m |= (a.v[l] > b.v[l]) << l) return m; }
+static inline vf vf_select(vmask m, vf a, vf b)		{ SFXR_LANES_(a.v[l] = (m >> l & 1)? a.v[l] : b.v[l]) return a; }
+
+static inline vi vi_load(int32_t const* p)			{ vi r; SFXR_LANES_(r.v[l] = p[l]) return r; }
+static inline void vi_store(int32_t * p, vi a)		{ SFXR_LANES_(p[l] = a.v[l]) }
+static inline vi vi_set1(int32_t a)					{ vi r; SFXR_LANES_(r.v[l] = a) return r; }
+static inline vi vi_add(vi a, vi b)					{ SFXR_LANES_(a.v[l] = a.v[l] + b.v[l]) return a; }
+static inline vi vi_sub(vi a, vi b)					{ SFXR_LANES_(a.v[l] = a.v[l] - b.v[l]) return a; }
+static inline vi vi_and(vi a, vi b)					{ SFXR_LANES_(a.v[l] = a.v[l] & b.v[l]) return a; }
+static inline vi vi_sll(vi a, int n)				{ SFXR_LANES_(a.v[l] = a.v[l] << n) return a; }
+static inline vi vi_srl(vi a, int n)				{ SFXR_LANES_(a.v[l] = (int32_t)((uint32_t)a.v[l] >> n)) return a; }
+static inline vi vi_xor(vi a, vi b)					{ SFXR_LANES_(a.v[l] = a.v[l] ^ b.v[l]) return a; }
+static inline vmask vi_lt(vi a, vi b)				{ vmask m = 0; SFXR_LANES_(m |= (a.v[l] < b.v[l]) << l) return m; }
+static inline vmask vi_eq(vi a, vi b)				{ vmask m = 0; SFXR_LANES_(m |= (a.v[l] == b.v[l]) << l) return m; }
+static inline vf vi_to_vf(vi a)						{ vf r; SFXR_LANES_(r.v[l] = (float)a.v[l]) return r; }
+static inline vi vf_to_vi(vf a)						{ vi r; SFXR_LANES_(r.v[l] = (int32_t)lrintf(a.v[l])) return r; }
+static inline void vi_store16(int16_t * p, vi a)	{ SFXR_LANES_(p[l] = a.v[l] < -32768? -32768 : a.v[l] > 32767? 32767 : a.v[l]) }
+static inline void vi_store8(uint8_t * p, vi a)		{ SFXR_LANES_(p[l] = a.v[l] < 0? 0 : a.v[l] > 255? 255 : a.v[l]) }
+static inline vf vf_gather(float const* p, vi i)	{ vf r; SFXR_LANES_(r.v[l] = p[i.v[l]]) return r; }
+
+static inline int vmask_bits(vmask m)				{ return m; }
+static inline float vf_hsum(vf a)					{ float r = 0; SFXR_LANES_(r += a.v[l]) return r; }
+
+#undef SFXR_LANES_
+
+#endif
+
+#endif // SFXR_SIMD_H
@@ -1,15 +1,31 @@
 #include "sfxr_soundeffects.h"
 #include <stdint.h>
 #include <assert.h>
-#include <stdio.h>R
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <float.h>
+#include <stddef.h>
+#include "sfxr_simd.h"
 
 #if INCLUDE_WAV_EXPORT
 #include <stdarg.h>
 #endif
 
+#if INCLUDE_WAV_EXPORT && INCLUDE_BATCH_EXPORT
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#if INCLUDE_WAV_EXPORT && INCLUDE_SOUND_BANK
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 enum
 {
 	SAMPLE_RATE = 44100,
@@ -19,16 +35,185 @@ enum
 // __restrict is not true
 static int sfxr_InternalToReadable(struct sfxr_Settings * dst, struct sfxr_Settings const* src);
 static int sfxr_ReadableToInternal(struct sfxr_Settings * dst, struct sfxr_Settings const* src);
+// only converts the fields in groups (see sfxr_SettingsGroup)
+static int sfxr_ReadableToInternalGroups(struct sfxr_Settings * dst, struct sfxr_Settings const* src, unsigned int groups);
 
 #define nullptr 0L
 
-#define rnd(n) (rand()%(n+1))
+// internals sfxr_golden and sfxr_bench compare against are only exported with SFXR_UNIT_TESTS
+#if SFXR_UNIT_TESTS
+#define SFXR_TESTABLE
+#else
+#define SFXR_TESTABLE static
+#endif
+
+// xorshift32 per thread for the preset generators, so they neither lock nor share state with rand()
+static __thread unsigned int sfxr_thread_seed = 2463534242u;
+
+static unsigned int sfxr_Random(unsigned int * state)
+{
+	unsigned int x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return *state = x;
+}
+
+void sfxr_Seed(unsigned int seed)
+{
+// xorshift gets stuck on 0
+	sfxr_thread_seed = seed? seed : 2463534242u;
+}
+
+#define rnd(n) (sfxr_Random(&sfxr_thread_seed)%(n+1))
 static float frnd(float range)
 {
 	return (float)rnd(10000)/10000*range;
 }
 
-int sfxr_ModelInit(sfxr_Model * model, sfxr_Settings const* settings)
+// counter based so every entry is independent of the others, which lets the
+// compiler vectorize the refill; the same seed always gives the same noise.
+static void sfxr_DataRefillNoise(sfxr_Data * data)
+{
+	unsigned int base = data->noise_seed ^ (data->noise_counter++ * 0x9E3779B9u);
+
+	for(unsigned int i= 0;i<32;i++)
+	{
+		unsigned int x = base + i * 0x85EBCA6Bu;
+		x ^= x >> 16;
+		x *= 0x7FEB352Du;
+		x ^= x >> 15;
+		x *= 0x846CA68Bu;
+		x ^= x >> 16;
+		data->noise_buffer[i]= (float)(int)(x >> 8) * (2.0f/16777216.0f) - 1.0f;
+	}
+}
+
+// recomputes what the groups of settings in groups turn into, maker is in internal units.
+// a step at sample_rate covers scale steps at 44100:
+// counters shrink by scale, per step increments grow by it, per step multipliers are raised to it.
+// the low pass is a mass spring integrator so its spring constant goes up by scale squared (capped so it stays stable),
+// the high pass leak and the phaser offset are close enough to linear.
+static void sfxr_ModelDerive(sfxr_Model * model, sfxr_Settings const* maker, unsigned int groups)
+{
+	double scale = SAMPLE_RATE / (double)model->sample_rate;
+	int rescale = model->sample_rate != SAMPLE_RATE;
+
+	if(groups & sfxr_GroupWaveType)
+		model->wave_type= maker->wave_type;
+
+	// reset envelope
+	if(groups & sfxr_GroupEnvelope)
+	{
+		model->envelope.punch= maker->envelope.punchPercent;
+		model->env_length[0]= (int)(maker->envelope.attackSec*maker->envelope.attackSec*100000.0f);
+		model->env_length[1]= (int)(maker->envelope.sustainSec*maker->envelope.sustainSec*100000.0f);
+		model->env_length[2]= (int)(maker->envelope.decaySec*maker->envelope.decaySec*100000.0f);
+
+		if(rescale)
+		{
+			for(int i = 0; i < 3; ++i)
+				model->env_length[i]= (int)(model->env_length[i]/scale);
+		}
+	}
+
+	if(groups & sfxr_GroupFrequency)
+	{
+		model->frequency.base= maker->frequency.baseHz;
+		model->frequency.limit= maker->frequency.limitHz;
+		model->frequency.slide= maker->frequency.slideOctaves_s;
+		model->fmaxperiod= 100.0/(maker->frequency.limitHz*maker->frequency.limitHz+0.001);
+		model->fdslide= -pow((double)maker->frequency.slideOctaves_s2, 3.0)*0.000001;
+
+		if(rescale)
+		{
+			model->fmaxperiod/= scale;
+			model->fdslide*= scale*scale;
+		}
+	}
+
+	// reset vibrato
+	if(groups & sfxr_GroupVibrato)
+	{
+		model->vib_speed= pow(maker->vibrato.speedHz, 2.0f)*0.01f;
+		model->vib_amp= maker->vibrato.strengthPercent*0.5f;
+		if(rescale) model->vib_speed*= scale;
+	}
+
+	if(groups & sfxr_GroupArpeggiation)
+	{
+		model->arpeggiation.speed= maker->arpeggiation.speedSec;
+		if(maker->arpeggiation.frequencySemitones>= 0.0f)
+			model->arp_mod= 1.0-pow((double)maker->arpeggiation.frequencySemitones, 2.0)*0.9;
+		else
+			model->arp_mod= 1.0+pow((double)maker->arpeggiation.frequencySemitones, 2.0)*10.0;
+	}
+
+	if(groups & sfxr_GroupDuty)
+	{
+		model->duty.cycle= maker->duty.cyclePercent;
+		model->square_duty= 0.5f-model->duty.cycle*0.5f;
+		model->square_slide= -maker->duty.sweepPercent_sec*0.00005f;
+		if(rescale) model->square_slide*= scale;
+	}
+
+	if(groups & sfxr_GroupRetrigger)
+	{
+		model->rep_limit= (int)(pow(1.0f-maker->retrigger.rateHz, 2.0f)*20000+32);
+		if(maker->retrigger.rateHz== 0.0f)
+			model->rep_limit= 0;
+
+		if(rescale && model->rep_limit!= 0)
+		{
+			model->rep_limit= (int)(model->rep_limit/scale);
+			if(model->rep_limit< 1) model->rep_limit= 1;
+		}
+	}
+
+	if(groups & sfxr_GroupFlanger)
+	{
+		model->flanger.offset= maker->flanger.offsetMs_sec;
+		model->fdphase= pow(maker->flanger.sweepMs_sec2, 2.0f)*1.0f;
+		if(maker->flanger.sweepMs_sec2<0.0f) model->fdphase= -model->fdphase;
+	}
+
+	// reset filter
+	if(groups & sfxr_GroupLowPass)
+	{
+		model->lowPassFilter.frequency= maker->lowPassFilter.cutoffFrequencyHz;
+		float fltw= pow(model->lowPassFilter.frequency, 3.0f)*0.1f;
+		model->fltw_d= 1.0f+maker->lowPassFilter.cuttofSweep_sec*0.0001f;
+		model->fltdmp= 5.0f/(1.0f+pow(maker->lowPassFilter.resonancePercent, 2.0f)*20.0f)*(0.01f+fltw);
+		if(model->fltdmp>0.8f) model->fltdmp= 0.8f;
+		model->fltw_max= 0.1f;
+
+		if(rescale)
+		{
+			model->fltw_d= pow(model->fltw_d, scale);
+			model->fltdmp= 1.0-pow(1.0-model->fltdmp, scale);
+			model->fltw_max= 0.1*scale*scale;
+			if(model->fltw_max>1.5f) model->fltw_max= 1.5f;
+		}
+
+		model->bl_fltw_d= pow(model->fltw_d, 8.0f);
+	}
+
+	if(groups & sfxr_GroupHighPass)
+	{
+		model->highPassFilter.frequency= maker->highPassFilter.cutoffFrequencyHz;
+		model->flthp_min= 0.00001f;
+		model->flthp_max= 0.1f;
+
+		if(rescale)
+		{
+			model->flthp_min= 0.00001*scale;
+			model->flthp_max= 0.1*scale;
+			if(model->flthp_max>0.9f) model->flthp_max= 0.9f;
+		}
+	}
+}
+
+static int sfxr_ModelInitAt(sfxr_Model * model, sfxr_Settings const* settings, int sample_rate)
 {
 	if(model == 0L || settings == 0L) return -1;
 
@@ -37,51 +222,174 @@ int sfxr_ModelInit(sfxr_Model * model, sfxr_Settings const* settings)
 
 	memset(model, 0, sizeof(*model));
 
-	model->wave_type					= maker.wave_type;
-	model->frequency.base				= maker.frequency.baseHz;
-	model->frequency.limit				= maker.frequency.limitHz;
-	model->frequency.slide				= maker.frequency.slideOctaves_s;
-	model->envelope.punch				= maker.envelope.punchPercent;
-	model->highPassFilter.frequency		= maker.highPassFilter.cutoffFrequencyHz;
-	model->lowPassFilter.frequency		= maker.lowPassFilter.cutoffFrequencyHz;
-	model->flanger.offset				= maker.flanger.offsetMs_sec;
-	model->duty.cycle					= maker.duty.cyclePercent;
-	model->arpeggiation.speed			= maker.arpeggiation.speedSec;
-
-	model->fmaxperiod= 100.0/(maker.frequency.limitHz*maker.frequency.limitHz+0.001);
-	model->fdslide= -pow((double)maker.frequency.slideOctaves_s2, 3.0)*0.000001;
-	model->square_duty= 0.5f-model->duty.cycle*0.5f;
-	model->square_slide= -maker.duty.sweepPercent_sec*0.00005f;
-	if(maker.arpeggiation.frequencySemitones>= 0.0f)
-		model->arp_mod= 1.0-pow((double)maker.arpeggiation.frequencySemitones, 2.0)*0.9;
-	else
-		model->arp_mod= 1.0+pow((double)maker.arpeggiation.frequencySemitones, 2.0)*10.0;
+	model->sample_rate= sample_rate;
+	model->time_scale= SAMPLE_RATE / (double)sample_rate;
 
-	// reset filter
-	float fltw= pow(model->lowPassFilter.frequency, 3.0f)*0.1f;
-	model->fltw_d= 1.0f+maker.lowPassFilter.cuttofSweep_sec*0.0001f;
-	model->fltdmp= 5.0f/(1.0f+pow(maker.lowPassFilter.resonancePercent, 2.0f)*20.0f)*(0.01f+fltw);
-	if(model->fltdmp>0.8f) model->fltdmp= 0.8f;
+	sfxr_ModelDerive(model, &maker, sfxr_GroupAll);
+	return 0;
+}
 
-	// reset vibrato
-	model->vib_speed= pow(maker.vibrato.speedHz, 2.0f)*0.01f;
-	model->vib_amp= maker.vibrato.strengthPercent*0.5f;
-	// reset envelope
-	model->env_length[0]= (int)(maker.envelope.attackSec*maker.envelope.attackSec*100000.0f);
-	model->env_length[1]= (int)(maker.envelope.sustainSec*maker.envelope.sustainSec*100000.0f);
-	model->env_length[2]= (int)(maker.envelope.decaySec*maker.envelope.decaySec*100000.0f);
+int sfxr_ModelInit(sfxr_Model * model, sfxr_Settings const* settings)
+{
+	return sfxr_ModelInitAt(model, settings, SAMPLE_RATE);
+}
+
+int sfxr_ModelInitRate(sfxr_Model * model, sfxr_Settings const* settings, int sample_rate)
+{
+	if(sample_rate <= 0 || sample_rate > SFXR_MAX_SAMPLE_RATE) return -1;
+	return sfxr_ModelInitAt(model, settings, sample_rate);
+}
+
+int sfxr_ModelUpdate(sfxr_Model * model, sfxr_Settings const* settings, unsigned int groups)
+{
+	if(model == 0L || settings == 0L) return -1;
+
+	sfxr_Settings maker;
+	sfxr_ReadableToInternalGroups(&maker, settings, groups);
+	sfxr_ModelDerive(model, &maker, groups);
 
-	model->fdphase= pow(maker.flanger.sweepMs_sec2, 2.0f)*1.0f;
-	if(maker.flanger.sweepMs_sec2<0.0f) model->fdphase= -model->fdphase;
+	return 0;
+}
 
-	model->rep_limit= (int)(pow(1.0f-maker.retrigger.rateHz, 2.0f)*20000+32);
-	if(maker.retrigger.rateHz== 0.0f)
-		model->rep_limit= 0;
+int sfxr_ModelSetWavetable(sfxr_Model * model, sfxr_Wavetable const* table)
+{
+	if(model == 0L) return -1;
 
+	model->wavetable= table;
 	return 0;
 }
 
+int sfxr_WavetableSize(int length)
+{
+	if(length < SFXR_WAVETABLE_MIN_LENGTH || length > SFXR_WAVETABLE_MAX_LENGTH || (length & (length-1))) return -1;
+
+// length + length/2 + ... + SFXR_WAVETABLE_MIN_LENGTH
+	return length*2-SFXR_WAVETABLE_MIN_LENGTH;
+}
+
+// the fourier series of the held cycle, and each level summed back up from the harmonics that fit in it.
+// sines and cosines are stepped by rotation so building a table costs no more than a few million multiplies.
+int sfxr_WavetableInit(sfxr_Wavetable * table, float * arena, int arena_length, float const* cycle, int cycle_length, int length)
+{
+	int size= sfxr_WavetableSize(length);
+	if(table == 0L || arena == 0L || cycle == 0L || cycle_length <= 0 || size < 0 || arena_length < size) return -1;
+
+	const double pi= 3.14159265358979;
+	double coefficients[SFXR_WAVETABLE_MAX_LENGTH];
+	int harmonics= length/2-1;
+
+	for(int h= 1;h<=harmonics;h++)
+	{
+		double step_c= cos(2*pi*h/length), step_s= sin(2*pi*h/length);
+		double c= 1.0, s= 0.0, a= 0.0, b= 0.0;
+
+		for(int i= 0;i<length;i++)
+		{
+			double sample= cycle[(long)i*cycle_length/length];
+			a+= sample*c;
+			b+= sample*s;
+
+			double next= c*step_c-s*step_s;
+			s= s*step_c+c*step_s;
+			c= next;
+		}
+
+		coefficients[h*2]= a*2/length;
+		coefficients[h*2+1]= b*2/length;
+	}
+
+	table->levels= arena;
+	table->length= length;
+	table->level_count= 0;
+	for(table->shift= 0;(1 << table->shift)<length;table->shift++) {}
+
+	float * level= arena;
+	for(int level_length= length;level_length>=SFXR_WAVETABLE_MIN_LENGTH;level_length>>= 1)
+	{
+		memset(level, 0, level_length*sizeof(float));
+
+		for(int h= 1;h<level_length/2;h++)
+		{
+			double step_c= cos(2*pi*h/level_length), step_s= sin(2*pi*h/level_length);
+			double c= 1.0, s= 0.0;
+
+			for(int i= 0;i<level_length;i++)
+			{
+				level[i]+= (float)(coefficients[h*2]*c+coefficients[h*2+1]*s);
+
+				double next= c*step_c-s*step_s;
+				s= s*step_c+c*step_s;
+				c= next;
+			}
+		}
+
+		level+= level_length;
+		table->level_count++;
+	}
+
+	return size;
+}
+
+unsigned int sfxr_SettingsDiff(sfxr_Settings const* a, sfxr_Settings const* b)
+{
+	if(a == 0L || b == 0L) return sfxr_GroupAll;
+
+	unsigned int groups = 0;
+#define SFXR_DIFF(member, group) if(memcmp(&a->member, &b->member, sizeof(a->member)) != 0) groups |= group
+	SFXR_DIFF(wave_type, sfxr_GroupWaveType);
+	SFXR_DIFF(envelope, sfxr_GroupEnvelope);
+	SFXR_DIFF(frequency, sfxr_GroupFrequency);
+	SFXR_DIFF(vibrato, sfxr_GroupVibrato);
+	SFXR_DIFF(arpeggiation, sfxr_GroupArpeggiation);
+	SFXR_DIFF(duty, sfxr_GroupDuty);
+	SFXR_DIFF(retrigger, sfxr_GroupRetrigger);
+	SFXR_DIFF(flanger, sfxr_GroupFlanger);
+	SFXR_DIFF(lowPassFilter, sfxr_GroupLowPass);
+	SFXR_DIFF(highPassFilter, sfxr_GroupHighPass);
+#undef SFXR_DIFF
+
+	return groups;
+}
+
 int sfxr_DataReset(sfxr_Data * data);
+int sfxr_DataSeed(sfxr_Data * data, unsigned int seed);
+
+// period of the base frequency in steps at the model's sample rate
+static double sfxr_ModelBasePeriod(sfxr_Model const* model)
+{
+	double period= 100.0/(model->frequency.base*model->frequency.base+0.001);
+	if(model->time_scale!= 1.0f)
+		period/= model->time_scale;
+	return period;
+}
+
+// the filter and phaser values a sound starts from
+static void sfxr_DataStart(sfxr_Data * data, unsigned int groups)
+{
+	sfxr_Model const* model = data->model;
+
+	if(groups & sfxr_GroupLowPass)
+	{
+		data->fltw= pow(model->lowPassFilter.frequency, 3.0f)*0.1f;
+		if(model->time_scale!= 1.0f)
+			data->fltw*= model->time_scale*model->time_scale;
+	}
+
+	if(groups & sfxr_GroupHighPass)
+	{
+		data->flthp= pow(model->highPassFilter.frequency, 2.0f)*0.1f;
+		if(model->time_scale!= 1.0f)
+			data->flthp*= model->time_scale;
+	}
+
+	if(groups & sfxr_GroupFlanger)
+	{
+		data->fphase= pow(model->flanger.offset, 2.0f)*1020.0f;
+		if(model->flanger.offset<0.0f) data->fphase= -data->fphase;
+		data->fphase/= model->time_scale;
+		data->iphase= abs((int)data->fphase);
+	}
+}
 
 int sfxr_DataInit(sfxr_Data * data, sfxr_Model const* model)
 {
@@ -90,15 +398,19 @@ int sfxr_DataInit(sfxr_Data * data, sfxr_Model const* model)
 	data->phase= 0;
 	data->model = model;
 	data->playing_sample = 1;
+	data->held= 0;
+	data->automation= 0L;
+
+	data->transpose= 1.0;
+	data->base_period= sfxr_ModelBasePeriod(model);
+	data->fmaxperiod= model->fmaxperiod;
 
 	sfxr_DataReset(data);
 
 	// reset filter
 	data->fltp= 0.0f;
 	data->fltdp= 0.0f;
-	data->fltw= pow(model->lowPassFilter.frequency, 3.0f)*0.1f;
 	data->fltphp= 0.0f;
-	data->flthp= pow(model->highPassFilter.frequency, 2.0f)*0.1f;
 	// reset vibrato
 	data->vib_phase= 0.0f;
 	// reset envelope
@@ -106,15 +418,15 @@ int sfxr_DataInit(sfxr_Data * data, sfxr_Model const* model)
 	data->env_stage= 0;
 	data->env_time= 0;
 
-	data->fphase= pow(model->flanger.offset, 2.0f)*1020.0f;
-	if(model->flanger.offset<0.0f) data->fphase= -data->fphase;
-
-	data->iphase= abs((int)data->fphase);
+	sfxr_DataStart(data, sfxr_GroupLowPass|sfxr_GroupHighPass|sfxr_GroupFlanger);
 	data->ipp= 0;
+#if SFXR_COMPACT_VOICES
+	data->phaser_buffer= 0L;
+#else
 	memset(data->phaser_buffer, 0, sizeof(data->phaser_buffer));
+#endif
 
-	for(int i= 0;i<32;i++)
-		data->noise_buffer[i]= frnd(2.0f)-1.0f;
+	sfxr_DataSeed(data, 0);
 
 	data->rep_time= 0;
 
@@ -122,535 +434,3659 @@ int sfxr_DataInit(sfxr_Data * data, sfxr_Model const* model)
 }
 
 
-int sfxr_DataReset(sfxr_Data * data)
+int sfxr_DataSeed(sfxr_Data * data, unsigned int seed)
 {
 	if(data == 0L) return -1;
 
-	data->fperiod= 100.0/(data->model->frequency.base*data->model->frequency.base+0.001);
-	data->period= (int)data->fperiod;
-	data->fslide= 1.0-pow((double)data->model->frequency.slide, 3.0)*0.01;
-	data->square_duty= 0.5f-data->model->duty.cycle*0.5f;
-
-	data->arp_time= 0;
-	data->arp_limit= (int)(pow(1.0f-data->model->arpeggiation.speed, 2.0f)*20000+32);
-	if(data->model->arpeggiation.speed== 1.0f)
-		data->arp_limit= 0;
+	data->noise_seed= seed;
+	data->noise_counter= 0;
+	sfxr_DataRefillNoise(data);
 
 	return 0;
 }
 
-int sfxr_DataSynthSample(sfxr_Data * data, int length, float* buffer)
+// the delay line the voice renders through, null if it has none (only with SFXR_COMPACT_VOICES)
+// or its flanger is off, a zero offset only taps the sample just written
+static inline float * sfxr_DataPhaserLine(sfxr_Data const* data)
 {
-	if(data == 0L || data->model == 0L || buffer == 0L) return -1;
-	sfxr_Model const* model = data->model;
+	return sfxr_DataNeedsPhaser(data)? (float *)data->phaser_buffer : 0L;
+}
 
-	int i;
-	for(i= 0;i<length;i++)
-	{
-		if(!data->playing_sample)
-			break;
+int sfxr_DataNeedsPhaser(sfxr_Data const* data)
+{
+	if(data == 0L || data->model == 0L) return 0;
 
-		data->rep_time++;
-		if(model->rep_limit!= 0 && data->rep_time>= model->rep_limit)
-		{
-			data->rep_time= 0;
-			sfxr_DataReset(data);
-		}
+	return data->fphase!= 0.0f || data->model->fdphase!= 0.0f
+		|| (data->automation && data->automation->curves[sfxr_AutomateFlanger]);
+}
 
-		// frequency envelopes/arpeggios
-		data->arp_time++;
-		if(data->arp_limit!= 0 && data->arp_time>= data->arp_limit)
-		{
-			data->arp_limit= 0;
-			data->fperiod*= model->arp_mod;
-		}
-		data->fslide+= model->fdslide;
-		data->fperiod*= data->fslide;
-		if(data->fperiod>model->fmaxperiod)
-		{
-			data->fperiod= model->fmaxperiod;
-			if(model->frequency.limit>0.0f)
-				data->playing_sample= 0;
-		}
-		float rfperiod= data->fperiod;
-		if(model->vib_amp>0.0f)
-		{
-			data->vib_phase+= model->vib_speed;
-			rfperiod= data->fperiod*(1.0+sin(data->vib_phase)*model->vib_amp);
-		}
-		data->period= (int)rfperiod;
-		if(data->period<8) data->period= 8;
-		data->square_duty+= model->square_slide;
-		if(data->square_duty<0.0f) data->square_duty= 0.0f;
-		if(data->square_duty>0.5f) data->square_duty= 0.5f;
-		// volume envelope
-		data->env_time++;
-		if(data->env_time>model->env_length[data->env_stage])
-		{
-			data->env_time= 0;
-			data->env_stage++;
-			if(data->env_stage== 3)
-				data->playing_sample= 0;
-		}
-		if(data->env_stage== 0)
-			data->env_vol= (float)data->env_time/model->env_length[0];
-		if(data->env_stage== 1)
-			data->env_vol= 1.0f+pow(1.0f-(float)data->env_time/model->env_length[1], 1.0f)*2.0f*model->envelope.punch;
-		if(data->env_stage== 2)
-			data->env_vol= 1.0f-(float)data->env_time/model->env_length[2];
+int sfxr_DataSetPhaser(sfxr_Data * data, float * buffer)
+{
+	if(data == 0L) return -1;
 
-		// phaser step
-		data->fphase+= model->fdphase;
-		data->iphase= abs((int)data->fphase);
-		if(data->iphase>1023) data->iphase= 1023;
+#if SFXR_COMPACT_VOICES
+	if(buffer == 0L || !sfxr_DataNeedsPhaser(data))
+	{
+		data->phaser_buffer= 0L;
+		return 0;
+	}
 
-		if(model->flthp_d!= 0.0f)
-		{
-			data->flthp*= model->flthp_d;
-			if(data->flthp<0.00001f) data->flthp= 0.00001f;
-			if(data->flthp>0.1f) data->flthp= 0.1f;
-		}
+	memset(buffer, 0, SFXR_PHASER_LENGTH*sizeof(float));
+	data->phaser_buffer= buffer;
+	return 1;
+#else
+	(void)buffer;
+	return sfxr_DataNeedsPhaser(data)!= 0;
+#endif
+}
 
-		float ssample= 0.0f;
-		for(int si= 0;si<8;si++) // 8x supersampling
-		{
-			float sample= 0.0f;
-			data->phase++;
-			if(data->phase>= data->period)
-			{
-//				phase= 0;
-				data->phase%= data->period;
-				if(model->wave_type== 3)
-					for(int noise= 0;noise<32;noise++)
-						data->noise_buffer[noise]= frnd(2.0f)-1.0f;
-			}
-			// base waveform
-			float fp= (float)data->phase/data->period;
-			switch(model->wave_type)
-			{
-			case sfxr_Square: // square
-				if(fp<model->square_duty)
-					sample= 0.5f;
-				else
-					sample= -0.5f;
-				break;
-			case sfxr_Sawtooth: // sawtooth
-				sample= 1.0f-fp*2;
-				break;
-			case sfxr_Sine: // sine
-				sample= (float)sin(fp*2*3.14159265358);
-				break;
-			default: // noise
-				sample= data->noise_buffer[data->phase*32/data->period];
-				break;
-			}
-			// lp filter
-			float pp= data->fltp;
-			data->fltw*= model->fltw_d;
-			if(data->fltw<0.0f) data->fltw= 0.0f;
-			if(data->fltw>0.1f) data->fltw= 0.1f;
-			if(model->lowPassFilter.frequency!= 1.0f)
-			{
-				data->fltdp+= (sample-data->fltp)*data->fltw;
-				data->fltdp-= data->fltdp*model->fltdmp;
-			}
-			else
-			{
-				data->fltp= sample;
-				data->fltdp= 0.0f;
-			}
-			data->fltp+= data->fltdp;
-			// hp filter
-			data->fltphp+= data->fltp-pp;
-			data->fltphp-= data->fltphp*data->flthp;
-			sample= data->fltphp;
-			// phaser
-			data->phaser_buffer[data->ipp&1023]= sample;
-			sample+= data->phaser_buffer[(data->ipp-data->iphase+1024)&1023];
-			data->ipp= (data->ipp+1)&1023;
-			// final accumulation and envelope application
-			ssample+= sample*data->env_vol;
-		}
-		ssample= ssample * 0.125f;
+int sfxr_PhaserPoolInit(sfxr_PhaserPool * pool, float (*buffers)[SFXR_PHASER_LENGTH], int count)
+{
+	if(pool == 0L || (buffers == 0L && count > 0) || count < 0) return -1;
 
-		if(ssample>1.0f) ssample= 1.0f;
-		if(ssample<-1.0f) ssample= -1.0f;
-		*buffer++= ssample;
+	memset(pool, 0, sizeof(*pool));
+	pool->buffers= buffers;
+	pool->count= count;
+	pool->free= count > 0? 0 : -1;
+
+	for(int i= 0;i<count;i++)
+	{
+		int next= i+1<count? i+1 : -1;
+		memcpy(buffers[i], &next, sizeof(next));
 	}
 
-	return i;
+	return 0;
 }
 
-int sfxr_ComputeRemainingSamples(sfxr_Data const*__restrict data)
+int sfxr_DataTakePhaser(sfxr_Data * data, sfxr_PhaserPool * pool)
 {
-	if(data == 0L || data->model == 0L) return -1;
-	if(data->env_stage >= ENV_STAGES) return 0;
-
-	sfxr_Model const *__restrict model = data->model;
-
-	int playing_sample = data->playing_sample;
-	int arp_limit = data->arp_limit;
-	int rep_time = data->rep_time;
-	int arp_time = data->arp_time;
-	double fperiod = data->fperiod;
-	double fslide = data->fslide;
+	if(data == 0L || pool == 0L) return -1;
 
-	// add 1 to env_length at each step here b/c when sampling we use > not >=.
+	if(!sfxr_DataNeedsPhaser(data)) return 0;
+#if SFXR_COMPACT_VOICES
+	if(data->phaser_buffer) return 1;
 
-	size_t cur_env_elapsed = data->env_time;
-	for(int i = 0; i < data->env_stage; ++i)
+	if(pool->free < 0)
 	{
-		cur_env_elapsed += model->env_length[i]+1;
+		pool->misses++;
+		return -1;
 	}
 
-	size_t limits[4];
-	size_t max_env_remaining = ((size_t)model->env_length[0] + model->env_length[1] + model->env_length[2] + 3) - cur_env_elapsed;
+	float * buffer= pool->buffers[pool->free];
+	memcpy(&pool->free, buffer, sizeof(pool->free));
+	pool->used++;
 
-	size_t i = 0;
-	while(playing_sample && i < max_env_remaining)
-	{
-		assert(i < max_env_remaining);
-		assert(model->rep_limit == 0 || rep_time < model->rep_limit);
-		assert(arp_limit == 0 || arp_time < arp_limit);
+	return sfxr_DataSetPhaser(data, buffer);
+#else
+	return 1;
+#endif
+}
 
-		limits[0] = max_env_remaining - i;
-		limits[1] = model->rep_limit == 0? ~(size_t)0 : (size_t)(model->rep_limit - rep_time);
-		limits[2] = arp_limit == 0? ~(size_t)0 : (size_t)(arp_limit - arp_time);
+int sfxr_DataReleasePhaser(sfxr_Data * data, sfxr_PhaserPool * pool)
+{
+	if(data == 0L || pool == 0L) return -1;
 
-// which limit will we hit first?
-		int which = limits[0] < limits[1]? 0 : 1;
-		which = limits[which] < limits[2]? which : 2;
+#if SFXR_COMPACT_VOICES
+	float * buffer= data->phaser_buffer;
+	data->phaser_buffer= 0L;
 
-		if(model->fdslide <= 0 && fslide <= 1)
-			limits[3] = ~(size_t)0;
-		else
-		{
-// todo: find a faster way
-			for(limits[3] = 0; limits[3] < limits[which]; ++limits[3])
-			{
-				fslide += model->fdslide;
-				fperiod *= fslide;
-				if(fperiod > model->fmaxperiod)
-					break;
-			}
-		}
+	if(buffer == 0L || pool->count == 0
+	|| buffer < pool->buffers[0] || buffer >= pool->buffers[0]+(size_t)pool->count*SFXR_PHASER_LENGTH)
+		return 0;
 
-		which = limits[which] <= limits[3]? which : 3;
+	int index= (int)((buffer-pool->buffers[0])/SFXR_PHASER_LENGTH);
+	memcpy(buffer, &pool->free, sizeof(pool->free));
+	pool->free= index;
+	pool->used--;
+#endif
 
-		i		 += limits[which];
+	return 0;
+}
+
+// the frequency state a retrigger goes back to, sfxr_ComputeRemainingSamples has to agree with this
+static void sfxr_DataResetPitch(sfxr_Data const* data, double * fperiod, double * fslide, int * arp_limit)
+{
+	sfxr_Model const* model = data->model;
+
+	*fperiod= data->base_period;
+	*fslide= 1.0-pow((double)model->frequency.slide, 3.0)*0.01;
+
+	*arp_limit= (int)(pow(1.0f-model->arpeggiation.speed, 2.0f)*20000+32);
+	if(model->arpeggiation.speed== 1.0f)
+		*arp_limit= 0;
+
+	double scale= model->time_scale;
+	if(scale!= 1.0)
+	{
+		*fslide= pow(*fslide, scale);
+		*arp_limit= (int)(*arp_limit/scale);
+	}
+}
+
+int sfxr_DataReset(sfxr_Data * data)
+{
+	if(data == 0L) return -1;
+
+	sfxr_DataResetPitch(data, &data->fperiod, &data->fslide, &data->arp_limit);
+	data->period= (int)data->fperiod;
+	data->square_duty= 0.5f-data->model->duty.cycle*0.5f;
+	data->arp_time= 0;
+
+	return 0;
+}
+
+int sfxr_DataSetFrequency(sfxr_Data * data, float hz)
+{
+	if(data == 0L || data->model == 0L || !(hz > 0.0f)) return -1;
+
+// fperiod counts subsamples, 8 to a sample
+	double period= 8.0*SAMPLE_RATE/hz/data->model->time_scale;
+	double ratio= period/data->base_period;
+
+	data->transpose*= ratio;
+	data->base_period= period;
+	data->fmaxperiod*= ratio;
+	data->fperiod*= ratio;
+	data->period= (int)data->fperiod;
+
+	return 0;
+}
+
+int sfxr_DataUpdate(sfxr_Data * data, unsigned int groups)
+{
+	if(data == 0L || data->model == 0L) return -1;
+
+	sfxr_Model const* model = data->model;
+
+// the pitch moves by as much as the base did, keeping any note or slide on top of it
+	if(groups & sfxr_GroupFrequency)
+	{
+		double period= sfxr_ModelBasePeriod(model)*data->transpose;
+
+		data->fperiod*= period/data->base_period;
+		data->period= (int)data->fperiod;
+		data->base_period= period;
+		data->fmaxperiod= model->fmaxperiod*data->transpose;
+	}
+
+	if(groups & (sfxr_GroupFrequency|sfxr_GroupArpeggiation))
+	{
+		double fperiod, fslide;
+		int arp_limit;
+		sfxr_DataResetPitch(data, &fperiod, &fslide, &arp_limit);
+
+		if(groups & sfxr_GroupFrequency)
+			data->fslide= fslide;
+// an arpeggio that already happened waits for the next retrigger
+		if((groups & sfxr_GroupArpeggiation) && data->arp_limit!= 0)
+			data->arp_limit= arp_limit;
+	}
+
+	if(groups & sfxr_GroupDuty)
+		data->square_duty= 0.5f-model->duty.cycle*0.5f;
+
+	sfxr_DataStart(data, groups & (sfxr_GroupLowPass|sfxr_GroupHighPass|sfxr_GroupFlanger));
+	return 0;
+}
+
+int sfxr_DataNoteOn(sfxr_Data * data, sfxr_Model const* model, int key)
+{
+	if(sfxr_DataInit(data, model) < 0) return -1;
+	if(sfxr_DataSetFrequency(data, MidiKeyToFrequency(key)) < 0) return -1;
+
+	data->held= 1;
+	return 0;
+}
+
+int sfxr_DataNoteOff(sfxr_Data * data)
+{
+	if(data == 0L || data->model == 0L) return -1;
+
+	data->held= 0;
+
+// start the decay at the current volume so releasing during the attack doesn't jump
+	if(data->env_stage< 2)
+	{
+		float level= data->env_vol< 1.0f? data->env_vol : 1.0f;
+		data->env_stage= 2;
+		data->env_time= (int)((1.0f-level)*data->model->env_length[2]);
+	}
+
+	return 0;
+}
+
+int sfxr_CurveInit(sfxr_Curve * curve, sfxr_Breakpoint * points, int capacity, float value)
+{
+	if(curve == 0L || points == 0L || capacity <= 0 || (capacity & (capacity-1))) return -1;
+
+	memset(curve, 0, sizeof(*curve));
+	curve->points= points;
+	curve->mask= capacity-1;
+	curve->from= value;
+	curve->value= value;
+
+	return 0;
+}
+
+int sfxr_CurvePush(sfxr_Curve * curve, float value, unsigned int samples)
+{
+	if(curve == 0L) return -1;
+
+	unsigned int head= __atomic_load_n(&curve->head, __ATOMIC_RELAXED);
+	unsigned int tail= __atomic_load_n(&curve->tail, __ATOMIC_ACQUIRE);
+	if(head-tail > curve->mask) return -1;
+
+	curve->points[head & curve->mask].value= value;
+	curve->points[head & curve->mask].samples= samples;
+	__atomic_store_n(&curve->head, head+1, __ATOMIC_RELEASE);
+
+	return 0;
+}
+
+// consumer side, moves the curve on by samples and returns its value there
+static float sfxr_CurveAdvance(sfxr_Curve * curve, unsigned int samples)
+{
+	unsigned int head= __atomic_load_n(&curve->head, __ATOMIC_ACQUIRE);
+	unsigned int tail= curve->tail;
+
+	while(tail!= head)
+	{
+		sfxr_Breakpoint const* point= &curve->points[tail & curve->mask];
+		unsigned int left= point->samples-curve->elapsed;
+
+		if(samples < left)
+		{
+			curve->elapsed+= samples;
+			curve->value= curve->from+(point->value-curve->from)*((float)curve->elapsed/point->samples);
+			break;
+		}
+
+		samples-= left;
+		curve->from= curve->value= point->value;
+		curve->elapsed= 0;
+		++tail;
+	}
+
+	__atomic_store_n(&curve->tail, tail, __ATOMIC_RELEASE);
+	return curve->value;
+}
+
+// readable units into what the voice works with at the model's sample rate, the same as
+// sfxr_ReadableToInternal followed by sfxr_DataStart works out to
+static float sfxr_AutomationInternal(sfxr_Model const* model, int target, float value)
+{
+	float scale= model->time_scale;
+
+	switch(target)
+	{
+	case sfxr_AutomateLowPass:
+		value= value/(value+8*SAMPLE_RATE)*scale*scale;
+		return value<0.0f? 0.0f : value>model->fltw_max? model->fltw_max : value;
+	case sfxr_AutomateHighPass:
+		value= value/(value+8*SAMPLE_RATE)*scale;
+		return value<model->flthp_min? model->flthp_min : value>model->flthp_max? model->flthp_max : value;
+	case sfxr_AutomateDuty:
+		value*= 0.01f;
+		return value<0.0f? 0.0f : value>0.5f? 0.5f : value;
+	case sfxr_AutomateFlanger:
+		return value*SAMPLE_RATE/1000/scale;
+	case sfxr_AutomatePitch:
+		return value>0.001f? value : 0.001f;
+	default:
+		return value;
+	}
+}
+
+int sfxr_AutomationInit(sfxr_Automation * automation)
+{
+	if(automation == 0L) return -1;
+
+	memset(automation, 0, sizeof(*automation));
+	return 0;
+}
+
+int sfxr_AutomationSet(sfxr_Automation * automation, enum sfxr_AutomationTarget target, sfxr_Curve * curve)
+{
+	if(automation == 0L || (unsigned)target >= sfxr_AutomateTargets) return -1;
+
+	automation->curves[target]= curve;
+	automation->remaining= 0;
+
+// start from the curve, not from whatever the target held before
+	if(curve!= 0L && automation->model!= 0L)
+		automation->value[target]= sfxr_AutomationInternal(automation->model, target, curve->value);
+
+	return 0;
+}
+
+// reads the curves at the end of the next block and sets up the ramps to get there
+static void sfxr_AutomationBlock(sfxr_Automation * automation, sfxr_Model const* model)
+{
+	for(int t= 0;t<sfxr_AutomateTargets;t++)
+	{
+		if(automation->curves[t]== 0L) continue;
+
+		float end= sfxr_AutomationInternal(model, t, sfxr_CurveAdvance(automation->curves[t], SFXR_AUTOMATION_BLOCK));
+		automation->step[t]= (end-automation->value[t])*(1.0f/SFXR_AUTOMATION_BLOCK);
+	}
+
+	automation->remaining= SFXR_AUTOMATION_BLOCK;
+}
+
+int sfxr_DataAutomate(sfxr_Data * data, sfxr_Automation * automation)
+{
+	if(data == 0L || data->model == 0L) return -1;
+
+	data->automation= automation;
+	if(automation == 0L) return 0;
+
+	automation->model= data->model;
+
+	for(int t= 0;t<sfxr_AutomateTargets;t++)
+	{
+		if(automation->curves[t]!= 0L)
+			automation->value[t]= sfxr_AutomationInternal(data->model, t, automation->curves[t]->value);
+	}
+
+	automation->remaining= 0;
+	return 0;
+}
+
+// the automated values for this step, on top of what the model did
+static void sfxr_AutomationApply(sfxr_Data * data, sfxr_Model const* model, float rfperiod)
+{
+	sfxr_Automation * automation= data->automation;
+
+	if(automation->remaining== 0)
+		sfxr_AutomationBlock(automation, model);
+	automation->remaining--;
+
+	for(int t= 0;t<sfxr_AutomateTargets;t++)
+		automation->value[t]+= automation->step[t];
+
+	if(automation->curves[sfxr_AutomatePitch])
+	{
+		data->period= (int)(rfperiod/automation->value[sfxr_AutomatePitch]);
+		if(data->period<8) data->period= 8;
+	}
+	if(automation->curves[sfxr_AutomateDuty])
+		data->square_duty= automation->value[sfxr_AutomateDuty];
+	if(automation->curves[sfxr_AutomateFlanger])
+	{
+		data->fphase= automation->value[sfxr_AutomateFlanger];
+		data->iphase= abs((int)data->fphase);
+		if(data->iphase>(SFXR_PHASER_LENGTH-1)) data->iphase= (SFXR_PHASER_LENGTH-1);
+	}
+	if(automation->curves[sfxr_AutomateHighPass])
+		data->flthp= automation->value[sfxr_AutomateHighPass];
+	if(automation->curves[sfxr_AutomateLowPass])
+		data->fltw= automation->value[sfxr_AutomateLowPass];
+}
+
+// the low pass runs unless the model's is off and nothing automates it
+static inline int sfxr_DataLowPass(sfxr_Data const* data)
+{
+	return data->model->lowPassFilter.frequency!= 1.0f
+		|| (data->automation && data->automation->curves[sfxr_AutomateLowPass]);
+}
+
+// what the waveform is multiplied by this step
+static inline float sfxr_DataAmplitude(sfxr_Data const* data)
+{
+	if(data->automation && data->automation->curves[sfxr_AutomateVolume])
+		return data->env_vol*data->automation->value[sfxr_AutomateVolume];
+	return data->env_vol;
+}
+
+// sin(2*pi*turns) for turns in [0, 1) for the fast oscillator, an odd minimax polynomial on a quarter turn.
+// within SFXR_FAST_SIN_ERROR of libm
+#define SFXR_FAST_SIN_ERROR 3e-7
+static inline float sfxr_FastSin(float turns)
+{
+	float x= turns>0.5f? turns-1.0f : turns;
+	if(x>0.25f) x= 0.5f-x;
+	if(x<-0.25f) x= -0.5f-x;
+	float x2= x*x;
+	return x*(6.283185160f+x2*(-41.34165502f+x2*(81.60100369f+x2*(-76.54977413f+x2*39.53664758f))));
+}
+
+// per output sample: retrigger, slides, arpeggio, vibrato, duty sweep, envelope and phaser offset.
+// every renderer goes through this so they all agree on the control state.
+static inline void sfxr_DataStep(sfxr_Data * data, sfxr_Model const* model)
+{
+	data->rep_time++;
+	if(model->rep_limit!= 0 && data->rep_time>= model->rep_limit)
+	{
+		data->rep_time= 0;
+		sfxr_DataReset(data);
+	}
+
+	// frequency envelopes/arpeggios
+	data->arp_time++;
+	if(data->arp_limit!= 0 && data->arp_time>= data->arp_limit)
+	{
+		data->arp_limit= 0;
+		data->fperiod*= model->arp_mod;
+	}
+	data->fslide+= model->fdslide;
+	data->fperiod*= data->fslide;
+	if(data->fperiod>data->fmaxperiod)
+	{
+		data->fperiod= data->fmaxperiod;
+		if(model->frequency.limit>0.0f)
+			data->playing_sample= 0;
+	}
+	float rfperiod= data->fperiod;
+	if(model->vib_amp>0.0f)
+	{
+		data->vib_phase+= model->vib_speed;
+		if(model->oscillator== sfxr_BandLimited)
+		{
+			// the phase only grows, take the whole turns off in double so the fraction keeps its precision
+			double turns= data->vib_phase*0.15915494309189535;
+			rfperiod= data->fperiod*(1.0+sfxr_FastSin((float)(turns-(long long)turns))*model->vib_amp);
+		}
+		else
+			rfperiod= data->fperiod*(1.0+sin(data->vib_phase)*model->vib_amp);
+	}
+	data->period= (int)rfperiod;
+	if(data->period<8) data->period= 8;
+	data->square_duty+= model->square_slide;
+	if(data->square_duty<0.0f) data->square_duty= 0.0f;
+	if(data->square_duty>0.5f) data->square_duty= 0.5f;
+	// volume envelope
+	data->env_time++;
+	if(data->env_time>model->env_length[data->env_stage])
+	{
+		if(data->held && data->env_stage== 1)
+		{
+			// held note, sit at the end of the sustain
+			data->env_time= model->env_length[1];
+		}
+		else
+		{
+			data->env_time= 0;
+			data->env_stage++;
+			if(data->env_stage== 3)
+				data->playing_sample= 0;
+		}
+	}
+	if(data->env_stage== 0)
+		data->env_vol= (float)data->env_time/model->env_length[0];
+	if(data->env_stage== 1)
+		data->env_vol= data->env_time>= model->env_length[1]? 1.0f :
+			1.0f+(double)(1.0f-(float)data->env_time/model->env_length[1])*2.0f*model->envelope.punch; // in double as the pow() it replaced was
+	if(data->env_stage== 2)
+		data->env_vol= 1.0f-(float)data->env_time/model->env_length[2];
+
+	// phaser step
+	data->fphase+= model->fdphase;
+	data->iphase= abs((int)data->fphase);
+	if(data->iphase>(SFXR_PHASER_LENGTH-1)) data->iphase= (SFXR_PHASER_LENGTH-1);
+
+	if(model->flthp_d!= 0.0f)
+	{
+		data->flthp*= model->flthp_d;
+		if(data->flthp<model->flthp_min) data->flthp= model->flthp_min;
+		if(data->flthp>model->flthp_max) data->flthp= model->flthp_max;
+	}
+
+	if(data->automation)
+		sfxr_AutomationApply(data, model, rfperiod);
+}
+
+// fp is the phase in [0, 1), period in subsamples picks the level
+static inline float sfxr_WavetableSample(sfxr_Wavetable const* table, float fp, int period)
+{
+	if(table== 0L) return 0.0f;
+
+	// the longest level that's no more samples than an output sample's worth of cycle
+	int cycle= period>>3;
+	int level= cycle<1? table->shift : table->shift-(31-__builtin_clz(cycle));
+	if(level<0) level= 0;
+	if(level>=table->level_count) level= table->level_count-1;
+
+	int length= table->length>>level;
+	float const* samples= table->levels+(table->length-length)*2;
+	float position= fp*length;
+	int i= (int)position;
+	float a= samples[i&(length-1)];
+	float b= samples[(i+1)&(length-1)];
+	return a+(b-a)*(position-i);
+}
+
+// base waveform at the current phase
+static inline float sfxr_DataOscillator(sfxr_Data * data, sfxr_Model const* model)
+{
+	float fp= (float)data->phase/data->period;
+	switch(model->wave_type)
+	{
+	case sfxr_Square: // square
+		// the swept duty, the original read the model's starting duty here so the duty sweep did nothing
+		if(fp<data->square_duty)
+			return 0.5f;
+		else
+			return -0.5f;
+	case sfxr_Sawtooth: // sawtooth
+		return 1.0f-fp*2;
+	case sfxr_Sine: // sine
+		return (float)sin(fp*2*3.14159265358);
+	case sfxr_Table: // wavetable
+		return sfxr_WavetableSample(model->wavetable, fp, data->period);
+	default: // noise
+		return data->noise_buffer[data->phase*32/data->period];
+	}
+}
+
+// oscillator, filters and phaser run 8 times per output sample
+static inline float sfxr_DataSupersample(sfxr_Data * data, sfxr_Model const* model)
+{
+	float ssample= 0.0f;
+	float amplitude= sfxr_DataAmplitude(data);
+	float * line= sfxr_DataPhaserLine(data);
+	int lowpass= sfxr_DataLowPass(data);
+	for(int si= 0;si<8;si++) // 8x supersampling
+	{
+		data->phase++;
+		if(data->phase>= data->period)
+		{
+//			phase= 0;
+			data->phase%= data->period;
+			if(model->wave_type== 3)
+				sfxr_DataRefillNoise(data);
+		}
+		// base waveform
+		float sample= sfxr_DataOscillator(data, model);
+		// lp filter
+		float pp= data->fltp;
+		data->fltw*= model->fltw_d;
+		if(data->fltw<0.0f) data->fltw= 0.0f;
+		if(data->fltw>model->fltw_max) data->fltw= model->fltw_max;
+		if(lowpass)
+		{
+			data->fltdp+= (sample-data->fltp)*data->fltw;
+			data->fltdp-= data->fltdp*model->fltdmp;
+		}
+		else
+		{
+			data->fltp= sample;
+			data->fltdp= 0.0f;
+		}
+		data->fltp+= data->fltdp;
+		// hp filter
+		data->fltphp+= data->fltp-pp;
+		data->fltphp-= data->fltphp*data->flthp;
+		sample= data->fltphp;
+		// phaser, without a delay line (no flanger) it's the sample added to itself
+		if(line)
+		{
+			line[data->ipp&(SFXR_PHASER_LENGTH-1)]= sample;
+			sample+= line[(data->ipp-data->iphase+SFXR_PHASER_LENGTH)&(SFXR_PHASER_LENGTH-1)];
+		}
+		else
+			sample+= sample;
+		data->ipp= (data->ipp+1)&(SFXR_PHASER_LENGTH-1);
+		// final accumulation and envelope application
+		ssample+= sample*amplitude;
+	}
+	return ssample * 0.125f;
+}
+
+// correction for a unit step at t= 0, t is the phase in [0, 1) and dt the phase increment
+static inline float sfxr_PolyBlep(float t, float dt)
+{
+	if(t<dt)
+	{
+		t/= dt;
+		return t+t-t*t-1.0f;
+	}
+	if(t>1.0f-dt)
+	{
+		t= (t-1.0f)/dt;
+		return t*t+t+t+1.0f;
+	}
+	return 0.0f;
+}
+
+// one step per output sample, the steps of the square and saw are smoothed with PolyBLEP
+// instead of averaging 8 subsamples so the filters and phaser only have to run once.
+static inline float sfxr_DataBandLimited(sfxr_Data * data, sfxr_Model const* model)
+{
+	data->phase+= 8;
+	if(data->phase>= data->period)
+	{
+		data->phase%= data->period;
+		if(model->wave_type== 3)
+			sfxr_DataRefillNoise(data);
+	}
+	// base waveform
+	float sample;
+	float fp= (float)data->phase/data->period;
+	float dt= 8.0f/data->period;
+	if(dt>0.5f) dt= 0.5f;
+	switch(model->wave_type)
+	{
+	case sfxr_Square: // square
+	{
+		float fd= fp-data->square_duty;
+		if(fd<0.0f) fd+= 1.0f;
+		sample= (fp<data->square_duty)? 0.5f : -0.5f;
+		sample+= (sfxr_PolyBlep(fp, dt)-sfxr_PolyBlep(fd, dt))*0.5f;
+	}	break;
+	case sfxr_Sawtooth: // sawtooth
+		sample= 1.0f-fp*2+sfxr_PolyBlep(fp, dt);
+		break;
+	case sfxr_Sine: // sine
+		sample= sfxr_FastSin(fp);
+		break;
+	default:
+		sample= sfxr_DataOscillator(data, model);
+		break;
+	}
+	// lp filter
+	// the filter is a mass spring integrator, holding the input, cutoff and damping for the 8 subsamples each step
+	// is linear in (fltp-sample, fltdp) so 8 of them are the step's matrix to the 8th power. the sweep moves the
+	// cutoff once per output sample (bl_fltw_d) where the reference moves it every subsample, and the high pass
+	// below only approximates its 8 steps.
+	float pp= data->fltp;
+	data->fltw*= model->bl_fltw_d;
+	if(data->fltw<0.0f) data->fltw= 0.0f;
+	if(data->fltw>model->fltw_max) data->fltw= model->fltw_max;
+	if(sfxr_DataLowPass(data))
+	{
+		float k= 1.0f-model->fltdmp;
+		float m00= 1.0f-k*data->fltw, m01= k;
+		float m10= -k*data->fltw, m11= k;
+		for(int i= 0;i<3;i++)
+		{
+			float n00= m00*m00+m01*m10, n01= m00*m01+m01*m11;
+			float n10= m10*m00+m11*m10, n11= m10*m01+m11*m11;
+			m00= n00; m01= n01; m10= n10; m11= n11;
+		}
+		float e= data->fltp-sample;
+		data->fltp= sample+m00*e+m01*data->fltdp;
+		data->fltdp= m10*e+m11*data->fltdp;
+	}
+	else
+	{
+		data->fltp= sample;
+		data->fltdp= 0.0f;
+	}
+	// hp filter, leaks what 8 subsamples would have
+	float hp= 1.0f-data->flthp;
+	hp*= hp; hp*= hp; hp*= hp;
+	data->fltphp+= data->fltp-pp;
+	data->fltphp*= hp;
+	sample= data->fltphp;
+	// phaser, the offset is in subsamples so interpolate between output samples
+	int tap= data->iphase>>3;
+	float frac= (data->iphase&7)*0.125f;
+	float * line= sfxr_DataPhaserLine(data);
+	if(line)
+	{
+		line[data->ipp&(SFXR_PHASER_LENGTH-1)]= sample;
+		float a= line[(data->ipp-tap+SFXR_PHASER_LENGTH)&(SFXR_PHASER_LENGTH-1)];
+		float b= line[(data->ipp-tap-1+SFXR_PHASER_LENGTH)&(SFXR_PHASER_LENGTH-1)];
+		sample+= a+(b-a)*frac;
+	}
+	else
+		sample+= sample;
+	data->ipp= (data->ipp+1)&(SFXR_PHASER_LENGTH-1);
+
+	return sample*sfxr_DataAmplitude(data);
+}
+
+int sfxr_DataSynthSample(sfxr_Data * data, int length, float* buffer)
+{
+	if(data == 0L || data->model == 0L || buffer == 0L) return -1;
+	sfxr_Model const* model = data->model;
+
+	int i;
+	for(i= 0;i<length;i++)
+	{
+		if(!data->playing_sample)
+			break;
+
+		sfxr_DataStep(data, model);
+		float ssample= model->oscillator== sfxr_BandLimited?
+			sfxr_DataBandLimited(data, model) : sfxr_DataSupersample(data, model);
+
+		if(ssample>1.0f) ssample= 1.0f;
+		if(ssample<-1.0f) ssample= -1.0f;
+		*buffer++= ssample;
+	}
+
+	return i;
+}
+
+/*
+ * Multi voice renderer.
+ *
+ * Up to SFXR_SIMD_WIDTH voices are packed into a structure of arrays and stepped in lockstep,
+ * the control stage (sfxr_DataStep) stays scalar per voice because it is double precision and
+ * only runs once per output sample, the 8x supersampled oscillator/filter/phaser loop runs across the lanes.
+ *
+ * Each lane performs exactly the float operations the scalar loop does, in the same order,
+ * so the output matches sfxr_DataSynthSample bit for bit as long as the compiler isn't allowed
+ * to contract a*b+c into an fma (build with -ffp-contract=off when targeting fma hardware).
+ * Sine and noise lanes are evaluated per lane.
+ */
+struct sfxr_Lanes
+{
+	SFXR_ALIGNED int32_t phase[SFXR_SIMD_WIDTH];
+	SFXR_ALIGNED int32_t period[SFXR_SIMD_WIDTH];
+	SFXR_ALIGNED int32_t wave[SFXR_SIMD_WIDTH];
+	SFXR_ALIGNED float   duty[SFXR_SIMD_WIDTH];
+	SFXR_ALIGNED float   env_vol[SFXR_SIMD_WIDTH];
+	SFXR_ALIGNED float   flthp[SFXR_SIMD_WIDTH];
+	SFXR_ALIGNED float   fltp[SFXR_SIMD_WIDTH];
+	SFXR_ALIGNED float   fltdp[SFXR_SIMD_WIDTH];
+	SFXR_ALIGNED float   fltw[SFXR_SIMD_WIDTH];
+	SFXR_ALIGNED float   fltw_d[SFXR_SIMD_WIDTH];
+	SFXR_ALIGNED float   fltw_max[SFXR_SIMD_WIDTH];
+	SFXR_ALIGNED float   fltdmp[SFXR_SIMD_WIDTH];
+	SFXR_ALIGNED float   lp_bypass[SFXR_SIMD_WIDTH];
+	SFXR_ALIGNED float   fltphp[SFXR_SIMD_WIDTH];
+	SFXR_ALIGNED float   fp[SFXR_SIMD_WIDTH];
+	SFXR_ALIGNED float   sample[SFXR_SIMD_WIDTH];
+	int iphase[SFXR_SIMD_WIDTH];
+	int ipp[SFXR_SIMD_WIDTH];
+// lanes with a flanger write and tap their voice's own delay line in place
+	float * line[SFXR_SIMD_WIDTH];
+};
+
+static int sfxr_PopCount(unsigned int v)
+{
+	int count = 0;
+	for(; v; v &= v - 1) ++count;
+	return count;
+}
+
+static void sfxr_LanesLoad(struct sfxr_Lanes * lanes, int l, sfxr_Data const* d)
+{
+	sfxr_Model const* model = d->model;
+
+	lanes->phase[l]		= d->phase;
+	lanes->period[l]	= d->period < 1? 1 : d->period;
+	lanes->iphase[l]	= d->iphase;
+	lanes->wave[l]		= model->wave_type;
+	lanes->duty[l]		= d->square_duty;
+	lanes->env_vol[l]	= sfxr_DataAmplitude(d);
+	lanes->flthp[l]		= d->flthp;
+	lanes->fltp[l]		= d->fltp;
+	lanes->fltdp[l]		= d->fltdp;
+	lanes->fltw[l]		= d->fltw;
+	lanes->fltw_d[l]	= model->fltw_d;
+	lanes->fltw_max[l]	= model->fltw_max;
+	lanes->fltdmp[l]	= model->fltdmp;
+	lanes->lp_bypass[l]	= sfxr_DataLowPass(d)? 0.0f : 1.0f;
+	lanes->fltphp[l]	= d->fltphp;
+	lanes->ipp[l]		= d->ipp;
+	lanes->line[l]		= sfxr_DataPhaserLine(d);
+}
+
+// subsamples is how far the lanes have advanced since sfxr_LanesLoad
+static void sfxr_LanesStore(struct sfxr_Lanes const* lanes, int l, sfxr_Data * d, int subsamples)
+{
+	d->phase	= lanes->phase[l];
+	d->fltp		= lanes->fltp[l];
+	d->fltdp	= lanes->fltdp[l];
+	d->fltw		= lanes->fltw[l];
+	d->fltphp	= lanes->fltphp[l];
+	d->ipp		= (lanes->ipp[l] + subsamples)&(SFXR_PHASER_LENGTH-1);
+}
+
+static void sfxr_DataSynthLanes(struct sfxr_Lanes * lanes, sfxr_Data ** data, int voices, int length, float ** buffers, int * written)
+{
+	int active = 0, gathered = 0, phased = 0;
+
+	for(int l = 0; l < SFXR_SIMD_WIDTH; ++l)
+	{
+// unused lanes run on a copy of the first voice and are never written back
+		sfxr_LanesLoad(lanes, l, l < voices? data[l] : data[0]);
+
+		if(l < voices)
+		{
+			written[l] = 0;
+			active |= (data[l]->playing_sample != 0) << l;
+// square and saw are computed in the vector registers, sine, noise and wavetables per lane
+			if(lanes->wave[l] != sfxr_Square && lanes->wave[l] != sfxr_Sawtooth)
+				gathered |= 1 << l;
+			if(lanes->line[l])
+				phased |= 1 << l;
+		}
+	}
+
+	vf v_fltp	= vf_load(lanes->fltp);
+	vf v_fltdp	= vf_load(lanes->fltdp);
+	vf v_fltw	= vf_load(lanes->fltw);
+	vf v_fltphp	= vf_load(lanes->fltphp);
+	vi v_phase	= vi_load(lanes->phase);
+
+	vf const v_fltw_d	= vf_load(lanes->fltw_d);
+	vf const v_fltw_max	= vf_load(lanes->fltw_max);
+	vf const v_fltdmp	= vf_load(lanes->fltdmp);
+	vmask const bypass	= vf_gt(vf_load(lanes->lp_bypass), vf_set1(0.0f));
+	vmask const saw		= vi_eq(vi_load(lanes->wave), vi_set1(sfxr_Sawtooth));
+	vi const one		= vi_set1(1);
+	vf const zero		= vf_set1(0.0f);
+
+	int n = 0, i;
+	for(i = 0; i < length && active; ++i)
+	{
+		int stopped = 0;
+		for(int l = 0; l < voices; ++l)
+		{
+			if(active >> l & 1 && !data[l]->playing_sample)
+				stopped |= 1 << l;
+		}
+
+// once most lanes have finished the vector loop is mostly wasted work, the scalar loop finishes up the rest.
+		int handoff = sfxr_PopCount(active & ~stopped)*4 <= SFXR_SIMD_WIDTH;
+
+		if(stopped || handoff)
+		{
+			int retire = handoff? active : stopped;
+
+			vf_store(lanes->fltp, v_fltp);
+			vf_store(lanes->fltdp, v_fltdp);
+			vf_store(lanes->fltw, v_fltw);
+			vf_store(lanes->fltphp, v_fltphp);
+			vi_store(lanes->phase, v_phase);
+
+			for(int l = 0; l < voices; ++l)
+			{
+				if(!(retire >> l & 1)) continue;
+				sfxr_LanesStore(lanes, l, data[l], n);
+				written[l] = i;
+
+				if(!(stopped >> l & 1))
+					written[l] += sfxr_DataSynthSample(data[l], length - i, buffers[l] + i);
+			}
+
+			active &= ~retire;
+			if(!active) break;
+		}
+
+// automated low pass cutoffs are set by the control stage, the rest stay in the register
+		int automated = 0;
+		for(int l = 0; l < voices; ++l)
+		{
+			sfxr_Automation const* automation = data[l]->automation;
+			if(active >> l & 1 && automation && automation->curves[sfxr_AutomateLowPass])
+				automated |= 1 << l;
+		}
+
+		if(automated)
+			vf_store(lanes->fltw, v_fltw);
+
+		for(int l = 0; l < voices; ++l)
+		{
+			if(!(active >> l & 1)) continue;
+			sfxr_Data * d = data[l];
+
+			sfxr_DataStep(d, d->model);
+
+			lanes->period[l]	= d->period;
+			lanes->iphase[l]	= d->iphase;
+			lanes->duty[l]		= d->square_duty;
+			lanes->env_vol[l]	= sfxr_DataAmplitude(d);
+			lanes->flthp[l]		= d->flthp;
+			if(automated >> l & 1)
+				lanes->fltw[l]	= d->fltw;
+		}
+
+		if(automated)
+			v_fltw = vf_load(lanes->fltw);
+
+		vi const v_period	= vi_load(lanes->period);
+		vf const vf_period	= vi_to_vf(v_period);
+		vf const v_duty		= vf_load(lanes->duty);
+		vf const v_env		= vf_load(lanes->env_vol);
+		vf const v_flthp	= vf_load(lanes->flthp);
+
+		vf ssample = zero;
+		for(int si = 0; si < 8; si++, n++)
+		{
+			v_phase = vi_add(v_phase, one);
+
+			int wrap = ~vmask_bits(vi_lt(v_phase, v_period)) & active;
+			if(wrap)
+			{
+				vi_store(lanes->phase, v_phase);
+				for(int l = 0; l < voices; ++l)
+				{
+					if(!(wrap >> l & 1)) continue;
+					lanes->phase[l] %= lanes->period[l];
+					if(lanes->wave[l] == 3)
+						sfxr_DataRefillNoise(data[l]);
+				}
+				v_phase = vi_load(lanes->phase);
+			}
+
+			// base waveform
+			vf v_fp = vf_div(vi_to_vf(v_phase), vf_period);
+			vf v_sample = vf_select(saw,
+				vf_sub(vf_set1(1.0f), vf_mul(v_fp, vf_set1(2.0f))),
+				vf_select(vf_lt(v_fp, v_duty), vf_set1(0.5f), vf_set1(-0.5f)));
+
+			if(gathered & active)
+			{
+				vf_store(lanes->fp, v_fp);
+				vf_store(lanes->sample, v_sample);
+				vi_store(lanes->phase, v_phase);
+				for(int l = 0; l < voices; ++l)
+				{
+					if(!((gathered & active) >> l & 1)) continue;
+					if(lanes->wave[l] == sfxr_Sine)
+						lanes->sample[l] = (float)sin(lanes->fp[l]*2*3.14159265358);
+					else if(lanes->wave[l] == sfxr_Table)
+						lanes->sample[l] = sfxr_WavetableSample(data[l]->model->wavetable, lanes->fp[l], lanes->period[l]);
+					else
+						lanes->sample[l] = data[l]->noise_buffer[lanes->phase[l]*32/lanes->period[l]];
+				}
+				v_sample = vf_load(lanes->sample);
+			}
+
+			// lp filter
+			vf pp = v_fltp;
+			v_fltw = vf_mul(v_fltw, v_fltw_d);
+			v_fltw = vf_select(vf_lt(v_fltw, zero), zero, v_fltw);
+			v_fltw = vf_min(v_fltw_max, v_fltw);
+
+			vf dp = vf_add(v_fltdp, vf_mul(vf_sub(v_sample, v_fltp), v_fltw));
+			dp = vf_sub(dp, vf_mul(dp, v_fltdmp));
+			v_fltdp = vf_select(bypass, zero, dp);
+			v_fltp = vf_add(vf_select(bypass, v_sample, v_fltp), v_fltdp);
+
+			// hp filter
+			v_fltphp = vf_add(v_fltphp, vf_sub(v_fltp, pp));
+			v_fltphp = vf_sub(v_fltphp, vf_mul(v_fltphp, v_flthp));
+
+			// phaser, lanes without a delay line add the sample to itself
+			vf v_tap = v_fltphp;
+			if(phased & active)
+			{
+				vf_store(lanes->sample, v_fltphp);
+				for(int l = 0; l < voices; ++l)
+				{
+					if(!((phased & active) >> l & 1)) continue;
+					float * line = lanes->line[l];
+					int at = lanes->ipp[l] + n;
+					line[at&(SFXR_PHASER_LENGTH-1)] = lanes->sample[l];
+					lanes->sample[l] = line[(at - lanes->iphase[l] + SFXR_PHASER_LENGTH)&(SFXR_PHASER_LENGTH-1)];
+				}
+				v_tap = vf_load(lanes->sample);
+			}
+			v_sample = vf_add(v_fltphp, v_tap);
+
+			// final accumulation and envelope application
+			ssample = vf_add(ssample, vf_mul(v_sample, v_env));
+		}
+
+		ssample = vf_mul(ssample, vf_set1(0.125f));
+		ssample = vf_min(vf_set1(1.0f), ssample);
+		ssample = vf_max(vf_set1(-1.0f), ssample);
+		vf_store(lanes->sample, ssample);
+
+		for(int l = 0; l < voices; ++l)
+		{
+			if(active >> l & 1)
+				buffers[l][i] = lanes->sample[l];
+		}
+	}
+
+	vf_store(lanes->fltp, v_fltp);
+	vf_store(lanes->fltdp, v_fltdp);
+	vf_store(lanes->fltw, v_fltw);
+	vf_store(lanes->fltphp, v_fltphp);
+	vi_store(lanes->phase, v_phase);
+
+	for(int l = 0; l < voices; ++l)
+	{
+		if(!(active >> l & 1)) continue;
+		sfxr_LanesStore(lanes, l, data[l], n);
+		written[l] = i;
+	}
+}
+
+int sfxr_DataSynthSampleMulti(sfxr_Data ** data, int voices, int length, float ** buffers, int * written)
+{
+	if(data == 0L || buffers == 0L || written == 0L || voices < 0) return -1;
+
+	for(int v = 0; v < voices; ++v)
+	{
+		if(data[v] == 0L || data[v]->model == 0L || buffers[v] == 0L)
+			return -1;
+	}
+
+	struct sfxr_Lanes lanes;
+	sfxr_Data * batch[SFXR_SIMD_WIDTH];
+	float * batch_buffers[SFXR_SIMD_WIDTH];
+	int * batch_written[SFXR_SIMD_WIDTH];
+	int batch_result[SFXR_SIMD_WIDTH];
+	int count = 0;
+
+// band limited voices already only do one step per sample, they go through the scalar path
+	for(int v = 0; v < voices; ++v)
+	{
+		if(data[v]->model->oscillator == sfxr_BandLimited)
+		{
+			written[v] = sfxr_DataSynthSample(data[v], length, buffers[v]);
+			continue;
+		}
+
+		batch[count]			= data[v];
+		batch_buffers[count]	= buffers[v];
+		batch_written[count]	= &written[v];
+
+		if(++count == SFXR_SIMD_WIDTH)
+		{
+			sfxr_DataSynthLanes(&lanes, batch, count, length, batch_buffers, batch_result);
+			for(int l = 0; l < count; ++l)
+				*batch_written[l] = batch_result[l];
+			count = 0;
+		}
+	}
+
+	if(count)
+	{
+		sfxr_DataSynthLanes(&lanes, batch, count, length, batch_buffers, batch_result);
+		for(int l = 0; l < count; ++l)
+			*batch_written[l] = batch_result[l];
+	}
+
+	return 0;
+}
+
+// where a count of the remaining samples has got to; the stepped loop can pick up from any of these
+struct sfxr_Remaining
+{
+	size_t i;
+	int arp_limit;
+	int rep_time;
+	int arp_time;
+	double fperiod;
+	double fslide;
+};
+
+static void sfxr_RemainingInit(struct sfxr_Remaining * at, sfxr_Data const* data)
+{
+	at->i		  = 0;
+	at->arp_limit = data->arp_limit;
+	at->rep_time  = data->rep_time;
+	at->arp_time  = data->arp_time;
+	at->fperiod	  = data->fperiod;
+	at->fslide	  = data->fslide;
+}
+
+// samples left in the envelope, add 1 to env_length at each step here b/c when sampling we use > not >=.
+static size_t sfxr_RemainingEnvelope(sfxr_Data const* data)
+{
+	sfxr_Model const* model = data->model;
+
+	size_t cur_env_elapsed = data->env_time;
+	for(int i = 0; i < data->env_stage; ++i)
+	{
+		cur_env_elapsed += model->env_length[i]+1;
+	}
+
+	return ((size_t)model->env_length[0] + model->env_length[1] + model->env_length[2] + 3) - cur_env_elapsed;
+}
+
+// steps the slide one sample at a time from at, this is the reference the solver below has to agree with
+static size_t sfxr_StepRemaining(sfxr_Data const*__restrict data, struct sfxr_Remaining at, size_t max_env_remaining)
+{
+	sfxr_Model const *__restrict model = data->model;
+
+	int arp_limit = at.arp_limit;
+	int rep_time = at.rep_time;
+	int arp_time = at.arp_time;
+	double fperiod = at.fperiod;
+	double fslide = at.fslide;
+
+	size_t limits[4];
+	size_t i = at.i;
+	while(i < max_env_remaining)
+	{
+		assert(i < max_env_remaining);
+// an arpeggio landing on the same sample as a retrigger is handled first, leaving a 0 length retrigger segment
+		assert(model->rep_limit == 0 || rep_time <= model->rep_limit);
+		assert(arp_limit == 0 || arp_time < arp_limit);
+
+		limits[0] = max_env_remaining - i;
+		limits[1] = model->rep_limit == 0? ~(size_t)0 : (size_t)(model->rep_limit - rep_time);
+		limits[2] = arp_limit == 0? ~(size_t)0 : (size_t)(arp_limit - arp_time);
+
+// which limit will we hit first?
+		int which = limits[0] < limits[1]? 0 : 1;
+		which = limits[which] < limits[2]? which : 2;
+
+		if(model->fdslide <= 0 && fslide <= 1)
+			limits[3] = ~(size_t)0;
+		else
+		{
+			for(limits[3] = 0; limits[3] < limits[which]; ++limits[3])
+			{
+				fslide += model->fdslide;
+				fperiod *= fslide;
+				if(fperiod > data->fmaxperiod)
+					break;
+			}
+		}
+
+		which = limits[which] <= limits[3]? which : 3;
+
+		i		 += limits[which];
+		rep_time += limits[which];
+		arp_time += limits[which];
+
+		switch(which)
+		{
+		default:
+			return i;
+		case 1:
+		{
+			rep_time= 0;
+			arp_time= 0;
+			sfxr_DataResetPitch(data, &fperiod, &fslide, &arp_limit);
+		}	break;
+		case 2:
+		{
+			arp_limit = 0;
+			fperiod *= model->arp_mod;
+		} break;
+		case 3:
+		{
+			fperiod = data->fmaxperiod;
+			if(model->frequency.limit > 0.0f)
+				return i;
+		} break;
+		}
+	}
+
+	return i;
+}
+
+SFXR_TESTABLE int sfxr_ComputeRemainingSamplesStepped(sfxr_Data const*__restrict data)
+{
+	if(data == 0L || data->model == 0L) return -1;
+	if(data->env_stage >= ENV_STAGES || !data->playing_sample) return 0;
+
+	struct sfxr_Remaining at;
+	sfxr_RemainingInit(&at, data);
+	return sfxr_StepRemaining(data, at, sfxr_RemainingEnvelope(data));
+}
+
+/*
+ * Frequency limit crossing without stepping every sample.
+ *
+ * After k samples fslide is a+k*d and fperiod is fperiod*prod(a+i*d, i= 1..k),
+ * so log(fperiod) is a sum of logs which has a closed form (Euler-Maclaurin on log1p)
+ * that is accurate to about 1e-13. The increments log(a+i*d) are monotonic in i so the
+ * sequence has at most one turning point, on either side of it a bisection finds the crossing.
+ *
+ * The stepping loop accumulates rounding error in fslide, if the crossing is closer to
+ * fmaxperiod than that error could be we can't tell which sample the loop would stop at and
+ * report it so the caller can step instead.
+ */
+static double sfxr_LogSlideProduct(double a, double d, double k)
+{
+	if(k <= 0) return 0;
+
+	double r = d / a;
+	double u = r * k;
+	double integral;
+
+// (1+u)*log1p(u)-u cancels badly for small u, use its series instead
+	if(fabs(u) < 1e-2)
+	{
+		double term = k, sum = 0;
+		for(int j = 2; j < 10; ++j)
+		{
+			term *= (j == 2? u : -u);
+			sum += term / (j*(j-1));
+		}
+		integral = sum;
+	}
+	else
+		integral = ((1+u)*log1p(u) - u) / r;
+
+	double v = 1/(1+u);
+	return k*log(a) + integral + log1p(u)/2 + r*(v - 1)/12 - 2*r*r*r*(v*v*v - 1)/720;
+}
+
+// returns -1 when the answer is too close to call, otherwise 0 and
+// the same limits[3], fperiod and fslide the stepping loop would have left behind.
+static int sfxr_SolveSlideLimit(size_t * steps, double * fperiod, double * fslide, double * err, double fdslide, double fmaxperiod, size_t n)
+{
+	double a = *fslide, d = fdslide;
+	double p0 = *fperiod;
+
+	if(n == 0)
+	{
+		*steps = 0;
+		return 0;
+	}
+
+// terms have to stay positive for the logs
+	if(!(a > 0 && a + n*d > 0 && p0 > 0))
+		return -1;
+
+	size_t crossing = n+1;
+
+// a NaN limit never compares greater, the loop runs to the end
+	if(!isnan(fmaxperiod))
+	{
+		if(!(fmaxperiod > 0)) return -1;
+
+		double lp = log(p0);
+		double target = log(fmaxperiod);
+		double margin = *err + 1e-12 + (double)n*n*DBL_EPSILON;
+
+// turning point, the first i where log(a+i*d) changes sign
+		double turn = d == 0? (a >= 1? 0 : n) : (1 - a) / d;
+		size_t lo = 1, hi = n;
+
+		if(d > 0 || (d == 0 && a < 1))
+		{
+// falling then rising, only the rising part can cross, unless the first step already does
+			double f1 = lp + log(a + d);
+			if(fabs(f1 - target) < margin) return -1;
+			if(f1 > target)
+				crossing = 1;
+			else if(turn < n)
+				lo = turn < 1? 1 : (size_t)turn;
+			else
+				lo = n+1;
+		}
+		else if(d < 0)
+		{
+// rising then falling, only the rising part can cross
+			if(turn < 1) hi = 1;
+			else if(turn < n) hi = (size_t)turn;
+
+// turn is rounded, make sure hi is the peak
+			if(hi < n && sfxr_LogSlideProduct(a, d, hi+1) > sfxr_LogSlideProduct(a, d, hi))
+				++hi;
+		}
+
+		if(crossing > n && lo <= hi)
+		{
+			double fhi = lp + sfxr_LogSlideProduct(a, d, hi);
+			if(fabs(fhi - target) < margin) return -1;
+
+			if(fhi > target)
+			{
+				double flo = lp + sfxr_LogSlideProduct(a, d, lo);
+				if(fabs(flo - target) < margin) return -1;
+
+				if(flo > target)
+					crossing = lo;
+				else
+				{
+// flo <= target < fhi
+					while(hi - lo > 1)
+					{
+						size_t mid = lo + (hi - lo) / 2;
+						double fmid = lp + sfxr_LogSlideProduct(a, d, mid);
+						if(fabs(fmid - target) < margin) return -1;
+
+						if(fmid > target) hi = mid;
+						else			  lo = mid;
+					}
+					crossing = hi;
+				}
+			}
+		}
+	}
+
+	size_t advanced = crossing <= n? crossing : n;
+
+	*steps	 = crossing <= n? crossing-1 : n;
+	*fslide	 = a + advanced*d;
+	*fperiod = p0 * exp(sfxr_LogSlideProduct(a, d, advanced));
+	*err	+= 1e-12 + (double)advanced*advanced*DBL_EPSILON;
+
+	return 0;
+}
+
+int sfxr_ComputeRemainingSamples(sfxr_Data const*__restrict data)
+{
+	if(data == 0L || data->model == 0L) return -1;
+	if(data->env_stage >= ENV_STAGES || !data->playing_sample) return 0;
+
+	sfxr_Model const *__restrict model = data->model;
+
+	int arp_limit = data->arp_limit;
+	int rep_time = data->rep_time;
+	int arp_time = data->arp_time;
+	double fperiod = data->fperiod;
+	double fslide = data->fslide;
+// how far fperiod/fslide might have drifted from what stepping would give
+	double err = 0;
+// every retrigger restarts from the same state, so once one full cycle has been measured the rest can be skipped
+	size_t last_reset = ~(size_t)0;
+// the last state known to be exactly what stepping would have, if the solver can't decide stepping resumes here
+	struct sfxr_Remaining exact;
+	sfxr_RemainingInit(&exact, data);
+
+	size_t limits[4];
+	size_t max_env_remaining = sfxr_RemainingEnvelope(data);
+
+	size_t i = 0;
+	while(i < max_env_remaining)
+	{
+		limits[0] = max_env_remaining - i;
+		limits[1] = model->rep_limit == 0? ~(size_t)0 : (size_t)(model->rep_limit - rep_time);
+		limits[2] = arp_limit == 0? ~(size_t)0 : (size_t)(arp_limit - arp_time);
+
+		int which = limits[0] < limits[1]? 0 : 1;
+		which = limits[which] < limits[2]? which : 2;
+
+		if(model->fdslide <= 0 && fslide <= 1)
+			limits[3] = ~(size_t)0;
+		else if(sfxr_SolveSlideLimit(&limits[3], &fperiod, &fslide, &err, model->fdslide, data->fmaxperiod, limits[which]) < 0)
+			return sfxr_StepRemaining(data, exact, max_env_remaining);
+
+		which = limits[which] <= limits[3]? which : 3;
+
+		i		 += limits[which];
 		rep_time += limits[which];
 		arp_time += limits[which];
 
-		switch(which)
+		switch(which)
+		{
+		default:
+			return i;
+		case 1:
+		{
+			if(last_reset != ~(size_t)0)
+			{
+				size_t cycle = i - last_reset;
+				i += (max_env_remaining - i) / cycle * cycle;
+			}
+			last_reset = i;
+
+			rep_time= 0;
+			err		= 0;
+			arp_time= 0;
+			sfxr_DataResetPitch(data, &fperiod, &fslide, &arp_limit);
+
+			exact = (struct sfxr_Remaining){ i, arp_limit, rep_time, arp_time, fperiod, fslide };
+		}	break;
+		case 2:
+		{
+			arp_limit = 0;
+			fperiod *= model->arp_mod;
+		} break;
+		case 3:
+		{
+			fperiod = data->fmaxperiod;
+			if(model->frequency.limit > 0.0f)
+				return i;
+// clamped and still playing, every later sample sits on the limit; leave that to the loop
+			return sfxr_StepRemaining(data, exact, max_env_remaining);
+		} break;
+		}
+	}
+
+	return i;
+}
+
+enum
+{
+	SFXR_RESAMPLER_HALF = SFXR_RESAMPLER_TAPS/2,
+	SFXR_RESAMPLER_PHASE_BITS = 7,
+	SFXR_RESAMPLER_MIX_BITS = 32 - SFXR_RESAMPLER_PHASE_BITS
+};
+
+int sfxr_ResamplerInit(sfxr_Resampler * resampler, int dst_sample_rate, int src_sample_rate, int channels)
+{
+	if(resampler == nullptr || dst_sample_rate <= 0 || src_sample_rate <= 0
+	|| channels <= 0 || channels > SFXR_RESAMPLER_CHANNELS)
+		return -1;
+
+	assert(1 << SFXR_RESAMPLER_PHASE_BITS == SFXR_RESAMPLER_PHASES);
+
+	memset(resampler->history, 0, sizeof(resampler->history));
+	resampler->channels = channels;
+	resampler->write	= 0;
+	resampler->step		= ((unsigned long long)src_sample_rate << 32) / dst_sample_rate;
+	resampler->time		= 0;
+	resampler->filled	= 0;
+
+// cut off a little under whichever nyquist is lower, the blackman window takes care of the rest
+	const double pi = 3.14159265358979;
+	double cutoff = 0.9 * (dst_sample_rate < src_sample_rate? dst_sample_rate / (double)src_sample_rate : 1.0);
+
+// row p is the kernel for an output p/PHASES of a sample past the middle of the window,
+// rows are normalized so dc goes through untouched.
+	for(int p = 0; p <= SFXR_RESAMPLER_PHASES; ++p)
+	{
+		float * row = &resampler->coefficients[p*SFXR_RESAMPLER_TAPS];
+		double sum = 0;
+
+		for(int k = 0; k < SFXR_RESAMPLER_TAPS; ++k)
+		{
+			double x = k - SFXR_RESAMPLER_HALF + 1 - p / (double)SFXR_RESAMPLER_PHASES;
+			double u = x / SFXR_RESAMPLER_HALF;
+			double sinc = x == 0? 1.0 : sin(pi * cutoff * x) / (pi * cutoff * x);
+			double window = fabs(u) >= 1? 0.0 : 0.42 + 0.5*cos(pi * u) + 0.08*cos(2*pi * u);
+
+			row[k] = sinc * window;
+			sum += row[k];
+		}
+
+		for(int k = 0; k < SFXR_RESAMPLER_TAPS; ++k)
+			row[k] /= sum;
+	}
+
+	return 0;
+}
+
+int sfxr_ResamplerInputNeeded(sfxr_Resampler const* resampler, int frames)
+{
+	if(resampler == nullptr || frames <= 0) return 0;
+
+	unsigned long long last = resampler->time + (frames-1) * resampler->step;
+	long long needed = (long long)((last >> 32) + SFXR_RESAMPLER_HALF + 1) - (long long)resampler->filled;
+
+	return needed > 0? (int)needed : 0;
+}
+
+// number of outputs between the current time and the end of src_frames more input
+static int sfxr_ResamplerOutputLength(sfxr_Resampler const* resampler, int src_frames)
+{
+	unsigned long long end = (resampler->filled + src_frames) << 32;
+	if(end <= resampler->time) return 0;
+
+	return (int)((end - resampler->time + resampler->step - 1) / resampler->step);
+}
+
+static inline int sfxr_ResamplerReady(sfxr_Resampler const* resampler)
+{
+	return (resampler->time >> 32) + SFXR_RESAMPLER_HALF + 1 <= resampler->filled;
+}
+
+// the window is always the newest TAPS inputs, outputs are written as soon as their window is full
+static void sfxr_ResamplerFilter(sfxr_Resampler const* resampler, float * dst)
+{
+	unsigned int fraction = (unsigned int)resampler->time;
+	float const* row0 = &resampler->coefficients[(fraction >> SFXR_RESAMPLER_MIX_BITS) * SFXR_RESAMPLER_TAPS];
+	float const* row1 = row0 + SFXR_RESAMPLER_TAPS;
+	vf mix = vf_set1((fraction & ((1u << SFXR_RESAMPLER_MIX_BITS)-1)) * (1.f / (1u << SFXR_RESAMPLER_MIX_BITS)));
+
+	vf sum[SFXR_RESAMPLER_CHANNELS];
+	for(int c = 0; c < resampler->channels; ++c)
+		sum[c] = vf_set1(0.f);
+
+	for(int k = 0; k < SFXR_RESAMPLER_TAPS; k += SFXR_SIMD_WIDTH)
+	{
+		vf c0 = vf_loadu(row0 + k);
+		vf c1 = vf_loadu(row1 + k);
+		vf coefficient = vf_add(c0, vf_mul(mix, vf_sub(c1, c0)));
+
+		for(int c = 0; c < resampler->channels; ++c)
+			sum[c] = vf_add(sum[c], vf_mul(coefficient, vf_loadu(&resampler->history[c][resampler->write + k])));
+	}
+
+	for(int c = 0; c < resampler->channels; ++c)
+		dst[c] = vf_hsum(sum[c]);
+}
+
+static inline void sfxr_ResamplerPush(sfxr_Resampler * resampler, float const* src)
+{
+	for(int c = 0; c < resampler->channels; ++c)
+	{
+		resampler->history[c][resampler->write] = src[c];
+		resampler->history[c][resampler->write + SFXR_RESAMPLER_TAPS] = src[c];
+	}
+
+	resampler->write   = (resampler->write + 1) & (SFXR_RESAMPLER_TAPS-1);
+	resampler->filled += 1;
+}
+
+int sfxr_ResamplerRun(sfxr_Resampler * resampler, float * dst, int dst_frames, float const* src, int src_frames, int * consumed)
+{
+	if(resampler == nullptr || dst == nullptr || (src == nullptr && src_frames > 0)) return -1;
+
+	int channels = resampler->channels;
+	int read = 0, written = 0;
+
+	for(;;)
+	{
+		for(; written < dst_frames && sfxr_ResamplerReady(resampler); ++written)
+		{
+			sfxr_ResamplerFilter(resampler, dst + written*channels);
+			resampler->time += resampler->step;
+		}
+
+		if(read == src_frames || written == dst_frames)
+			break;
+
+		sfxr_ResamplerPush(resampler, src + read*channels);
+		++read;
+	}
+
+	if(consumed) *consumed = read;
+	return written;
+}
+
+int sfxr_ResamplerFlush(sfxr_Resampler * resampler, float * dst, int dst_frames)
+{
+	if(resampler == nullptr || dst == nullptr) return -1;
+
+	int frames = sfxr_ResamplerOutputLength(resampler, 0);
+	if(frames > dst_frames) frames = dst_frames;
+
+	static const float silence[SFXR_RESAMPLER_CHANNELS];
+	int written = 0;
+
+	while(written < frames)
+		written += sfxr_ResamplerRun(resampler, dst + written*resampler->channels, frames - written, silence, 1, nullptr);
+
+	return written;
+}
+
+static void sfxr_PutU16(unsigned char * dst, uint16_t v)
+{
+	dst[0] = v; dst[1] = v >> 8;
+}
+
+static void sfxr_PutU32(unsigned char * dst, uint32_t v)
+{
+	dst[0] = v; dst[1] = v >> 8; dst[2] = v >> 16; dst[3] = v >> 24;
+}
+
+static uint32_t sfxr_GetU32(unsigned char const* src)
+{
+	return src[0] | (uint32_t)src[1] << 8 | (uint32_t)src[2] << 16 | (uint32_t)src[3] << 24;
+}
+
+#if INCLUDE_WAV_EXPORT
+
+// here for reference, only uncompressed, ieee float and extensible are used. (found in ffmpeg)
+enum
+{
+	WAVE_FORMAT_UNKNOWN                    = 0x0000,	// Microsoft Corporation
+	WAVE_FORMAT_UNCOMPRESSED               = 0x0001,	// Microsoft Corporation
+	WAVE_FORMAT_ADPCM                      = 0x0002,	// Microsoft Corporation
+	WAVE_FORMAT_IEEE_FLOAT                 = 0x0003,	// Microsoft Corporation
+	WAVE_FORMAT_VSELP                      = 0x0004,	// Compaq Computer Corp.
+	WAVE_FORMAT_IBM_CVSD                   = 0x0005,	// IBM Corporation
+	WAVE_FORMAT_ALAW                       = 0x0006,	// Microsoft Corporation
+	WAVE_FORMAT_MULAW                      = 0x0007,	// Microsoft Corporation
+	WAVE_FORMAT_DTS                        = 0x0008,	// Microsoft Corporation
+	WAVE_FORMAT_OKI_ADPCM                  = 0x0010,	// OKI
+	WAVE_FORMAT_DVI_ADPCM                  = 0x0011,	// Intel Corporation
+	WAVE_FORMAT_IMA_ADPCM                  = (WAVE_FORMAT_DVI_ADPCM),	//  Intel Corporation
+	WAVE_FORMAT_MEDIASPACE_ADPCM           = 0x0012,	// Videologic
+	WAVE_FORMAT_SIERRA_ADPCM               = 0x0013,	// Sierra Semiconductor Corp
+	WAVE_FORMAT_G723_ADPCM                 = 0x0014,	// Antex Electronics Corporation
+	WAVE_FORMAT_DIGISTD                    = 0x0015,	// DSP Solutions, Inc.
+	WAVE_FORMAT_DIGIFIX                    = 0x0016,	// DSP Solutions, Inc.
+	WAVE_FORMAT_DIALOGIC_OKI_ADPCM         = 0x0017,	// Dialogic Corporation
+	WAVE_FORMAT_MEDIAVISION_ADPCM          = 0x0018,	// Media Vision, Inc.
+	WAVE_FORMAT_CU_CODEC                   = 0x0019,	// Hewlett-Packard Company
+	WAVE_FORMAT_YAMAHA_ADPCM               = 0x0020,	// Yamaha Corporation of America
+	WAVE_FORMAT_SONARC                     = 0x0021,	// Speech Compression
+	WAVE_FORMAT_DSPGROUP_TRUESPEECH        = 0x0022,	// DSP Group, Inc
+	WAVE_FORMAT_ECHOSC1                    = 0x0023,	// Echo Speech Corporation
+	WAVE_FORMAT_AUDIOFILE_AF36             = 0x0024,	// Virtual Music, Inc.
+	WAVE_FORMAT_APTX                       = 0x0025,	// Audio Processing Technology
+	WAVE_FORMAT_AUDIOFILE_AF10             = 0x0026,	// Virtual Music, Inc.
+	WAVE_FORMAT_PROSODY_1612               = 0x0027,	// Aculab plc
+	WAVE_FORMAT_LRC                        = 0x0028,	// Merging Technologies S.A.
+	WAVE_FORMAT_DOLBY_AC2                  = 0x0030,	// Dolby Laboratories
+	WAVE_FORMAT_GSM610                     = 0x0031,	// Microsoft Corporation
+	WAVE_FORMAT_MSNAUDIO                   = 0x0032,	// Microsoft Corporation
+	WAVE_FORMAT_ANTEX_ADPCME               = 0x0033,	// Antex Electronics Corporation
+	WAVE_FORMAT_CONTROL_RES_VQLPC          = 0x0034,	// Control Resources Limited
+	WAVE_FORMAT_DIGIREAL                   = 0x0035,	// DSP Solutions, Inc.
+	WAVE_FORMAT_DIGIADPCM                  = 0x0036,	// DSP Solutions, Inc.
+	WAVE_FORMAT_CONTROL_RES_CR10           = 0x0037,	// Control Resources Limited
+	WAVE_FORMAT_NMS_VBXADPCM               = 0x0038,	// Natural MicroSystems
+	WAVE_FORMAT_CS_IMAADPCM                = 0x0039,	// Crystal Semiconductor IMA ADPCM
+	WAVE_FORMAT_ECHOSC3                    = 0x003A,	// Echo Speech Corporation
+	WAVE_FORMAT_ROCKWELL_ADPCM             = 0x003B,	// Rockwell International
+	WAVE_FORMAT_ROCKWELL_DIGITALK          = 0x003C,	// Rockwell International
+	WAVE_FORMAT_XEBEC                      = 0x003D,	// Xebec Multimedia Solutions Limited
+	WAVE_FORMAT_G721_ADPCM                 = 0x0040,	// Antex Electronics Corporation
+	WAVE_FORMAT_G728_CELP                  = 0x0041,	// Antex Electronics Corporation
+	WAVE_FORMAT_MSG723                     = 0x0042,	// Microsoft Corporation
+	WAVE_FORMAT_MPEG                       = 0x0050,	// Microsoft Corporation
+	WAVE_FORMAT_RT24                       = 0x0052,	// InSoft, Inc.
+	WAVE_FORMAT_PAC                        = 0x0053,	// InSoft, Inc.
+	WAVE_FORMAT_MPEGLAYER3                 = 0x0055,	// ISO/MPEG Layer3 Format Tag
+	WAVE_FORMAT_LUCENT_G723                = 0x0059,	// Lucent Technologies
+	WAVE_FORMAT_CIRRUS                     = 0x0060,	// Cirrus Logic
+	WAVE_FORMAT_ESPCM                      = 0x0061,	// ESS Technology
+	WAVE_FORMAT_VOXWARE                    = 0x0062,	// Voxware Inc
+	WAVE_FORMAT_CANOPUS_ATRAC              = 0x0063,	// Canopus, co., Ltd.
+	WAVE_FORMAT_G726_ADPCM                 = 0x0064,	// APICOM
+	WAVE_FORMAT_G722_ADPCM                 = 0x0065,	// APICOM
+	WAVE_FORMAT_DSAT_DISPLAY               = 0x0067,	// Microsoft Corporation
+	WAVE_FORMAT_VOXWARE_BYTE_ALIGNED       = 0x0069,	// Voxware Inc
+	WAVE_FORMAT_VOXWARE_AC8                = 0x0070,	// Voxware Inc
+	WAVE_FORMAT_VOXWARE_AC10               = 0x0071,	// Voxware Inc
+	WAVE_FORMAT_VOXWARE_AC16               = 0x0072,	// Voxware Inc
+	WAVE_FORMAT_VOXWARE_AC20               = 0x0073,	// Voxware Inc
+	WAVE_FORMAT_VOXWARE_RT24               = 0x0074,	// Voxware Inc
+	WAVE_FORMAT_VOXWARE_RT29               = 0x0075,	// Voxware Inc
+	WAVE_FORMAT_VOXWARE_RT29HW             = 0x0076,	// Voxware Inc
+	WAVE_FORMAT_VOXWARE_VR12               = 0x0077,	// Voxware Inc
+	WAVE_FORMAT_VOXWARE_VR18               = 0x0078,	// Voxware Inc
+	WAVE_FORMAT_VOXWARE_TQ40               = 0x0079,	// Voxware Inc
+	WAVE_FORMAT_SOFTSOUND                  = 0x0080,	// Softsound, Ltd.
+	WAVE_FORMAT_VOXWARE_TQ60               = 0x0081,	// Voxware Inc
+	WAVE_FORMAT_MSRT24                     = 0x0082,	// Microsoft Corporation
+	WAVE_FORMAT_G729A                      = 0x0083,	// AT&T Labs, Inc.
+	WAVE_FORMAT_MVI_MVI2                   = 0x0084,	// Motion Pixels
+	WAVE_FORMAT_DF_G726                    = 0x0085,	// DataFusion Systems (Pty) (Ltd)
+	WAVE_FORMAT_DF_GSM610                  = 0x0086,	// DataFusion Systems (Pty) (Ltd)
+	WAVE_FORMAT_ISIAUDIO                   = 0x0088,	// Iterated Systems, Inc.
+	WAVE_FORMAT_ONLIVE                     = 0x0089,	// OnLive! Technologies, Inc.
+	WAVE_FORMAT_SBC24                      = 0x0091,	// Siemens Business Communications Sys
+	WAVE_FORMAT_DOLBY_AC3_SPDIF            = 0x0092,	// Sonic Foundry
+	WAVE_FORMAT_MEDIASONIC_G723            = 0x0093,	// MediaSonic
+	WAVE_FORMAT_PROSODY_8KBPS              = 0x0094,	// Aculab plc
+	WAVE_FORMAT_ZYXEL_ADPCM                = 0x0097,	// ZyXEL Communications, Inc.
+	WAVE_FORMAT_PHILIPS_LPCBB              = 0x0098,	// Philips Speech Processing
+	WAVE_FORMAT_PACKED                     = 0x0099,	// Studer Professional Audio AG
+	WAVE_FORMAT_MALDEN_PHONYTALK           = 0x00A0,	// Malden Electronics Ltd.
+	WAVE_FORMAT_RHETOREX_ADPCM             = 0x0100,	// Rhetorex Inc.
+	WAVE_FORMAT_IRAT                       = 0x0101,	// BeCubed Software Inc.
+	WAVE_FORMAT_VIVO_G723                  = 0x0111,	// Vivo Software
+	WAVE_FORMAT_VIVO_SIREN                 = 0x0112,	// Vivo Software
+	WAVE_FORMAT_DIGITAL_G723               = 0x0123,	// Digital Equipment Corporation
+	WAVE_FORMAT_SANYO_LD_ADPCM             = 0x0125,	// Sanyo Electric Co., Ltd.
+	WAVE_FORMAT_SIPROLAB_ACEPLNET          = 0x0130,	// Sipro Lab Telecom Inc.
+	WAVE_FORMAT_SIPROLAB_ACELP4800         = 0x0131,	// Sipro Lab Telecom Inc.
+	WAVE_FORMAT_SIPROLAB_ACELP8V3          = 0x0132,	// Sipro Lab Telecom Inc.
+	WAVE_FORMAT_SIPROLAB_G729              = 0x0133,	// Sipro Lab Telecom Inc.
+	WAVE_FORMAT_SIPROLAB_G729A             = 0x0134,	// Sipro Lab Telecom Inc.
+	WAVE_FORMAT_SIPROLAB_KELVIN            = 0x0135,	// Sipro Lab Telecom Inc.
+	WAVE_FORMAT_G726ADPCM                  = 0x0140,	// Dictaphone Corporation
+	WAVE_FORMAT_QUALCOMM_PUREVOICE         = 0x0150,	// Qualcomm, Inc.
+	WAVE_FORMAT_QUALCOMM_HALFRATE          = 0x0151,	// Qualcomm, Inc.
+	WAVE_FORMAT_TUBGSM                     = 0x0155,	// Ring Zero Systems, Inc.
+	WAVE_FORMAT_MSAUDIO1                   = 0x0160,	// Microsoft Corporation
+	WAVE_FORMAT_CREATIVE_ADPCM             = 0x0200,	// Creative Labs, Inc
+	WAVE_FORMAT_CREATIVE_FASTSPEECH8       = 0x0202,	// Creative Labs, Inc
+	WAVE_FORMAT_CREATIVE_FASTSPEECH10      = 0x0203,	// Creative Labs, Inc
+	WAVE_FORMAT_UHER_ADPCM                 = 0x0210,	// UHER informatic GmbH
+	WAVE_FORMAT_QUARTERDECK                = 0x0220,	// Quarterdeck Corporation
+	WAVE_FORMAT_ILINK_VC                   = 0x0230,	// I-link Worldwide
+	WAVE_FORMAT_RAW_SPORT                  = 0x0240,	// Aureal Semiconductor
+	WAVE_FORMAT_IPI_HSX                    = 0x0250,	// Interactive Products, Inc.
+	WAVE_FORMAT_IPI_RPELP                  = 0x0251,	// Interactive Products, Inc.
+	WAVE_FORMAT_CS2                        = 0x0260,	// Consistent Software
+	WAVE_FORMAT_SONY_SCX                   = 0x0270,	// Sony Corp.
+	WAVE_FORMAT_FM_TOWNS_SND               = 0x0300,	// Fujitsu Corp.
+	WAVE_FORMAT_BTV_DIGITAL                = 0x0400,	// Brooktree Corporation
+	WAVE_FORMAT_QDESIGN_MUSIC              = 0x0450,	// QDesign Corporation
+	WAVE_FORMAT_VME_VMPCM                  = 0x0680,	// AT&T Labs, Inc.
+	WAVE_FORMAT_TPC                        = 0x0681,	// AT&T Labs, Inc.
+	WAVE_FORMAT_OLIGSM                     = 0x1000,	// Ing C. Olivetti & C., S.p.A.
+	WAVE_FORMAT_OLIADPCM                   = 0x1001,	// Ing C. Olivetti & C., S.p.A.
+	WAVE_FORMAT_OLICELP                    = 0x1002,	// Ing C. Olivetti & C., S.p.A.
+	WAVE_FORMAT_OLISBC                     = 0x1003,	// Ing C. Olivetti & C., S.p.A.
+	WAVE_FORMAT_OLIOPR                     = 0x1004,	// Ing C. Olivetti & C., S.p.A.
+	WAVE_FORMAT_LH_CODEC                   = 0x1100,	// Lernout & Hauspie
+	WAVE_FORMAT_NORRIS                     = 0x1400,	// Norris Communications, Inc.
+	WAVE_FORMAT_SOUNDSPACE_MUSICOMPRESS    = 0x1500,	// AT&T Labs, Inc.
+	WAVE_FORMAT_DVM                        = 0x2000,	// FAST Multimedia AG
+	WAVE_FORMAT_EXTENSIBLE                 = 0xFFFE,	// Microsoft Corporation
+};
+
+enum
+{
+	SFXR_EXPORT_BLOCK = 4096
+};
+
+static int sfxr_HostLittleEndian(void)
+{
+	uint32_t one = 1;
+	return *(unsigned char const*)&one == 1;
+}
+
+// wav and bank pcm is little endian, sfxr_Quantize leaves 16 and 32 bit samples in host order
+// (24 bit is packed little endian already) so a big endian host swaps them before writing
+static void sfxr_PcmToLittleEndian(void * pcm, int samples, int wav_bits)
+{
+	if(sfxr_HostLittleEndian() || (wav_bits != 16 && wav_bits != 32))
+		return;
+
+	unsigned char * bytes = pcm;
+	int size = wav_bits/8;
+	for(int i = 0; i < samples*size; i += size)
+	{
+		for(int a = i, b = i + size-1; a < b; ++a, --b)
+		{
+			unsigned char c = bytes[a];
+			bytes[a] = bytes[b];
+			bytes[b] = c;
+		}
+	}
+}
+
+// gets each block of a sound as it's rendered, free to overwrite it
+typedef void (*sfxr_BlockSink)(void * user, float * block, int samples);
+
+// renders the sound at sample_rate and hands it to sink, returns the number of samples made.
+// up to 44100 it's synthesized at sample_rate, above that at 44100 and resampled,
+// one block at a time so memory use doesn't depend on the length of the sound
+static int sfxr_RenderSound(sfxr_Settings const* s, int sample_rate, sfxr_BlockSink sink, void * user)
+{
+	sfxr_Model model;
+	sfxr_Data  data;
+#if SFXR_COMPACT_VOICES
+	float phaser[SFXR_PHASER_LENGTH];
+#endif
+
+	int synth_rate = sample_rate < SAMPLE_RATE? sample_rate : SAMPLE_RATE;
+	if(sfxr_ModelInitRate(&model, s, synth_rate) < 0)
+		return -1;
+	sfxr_DataInit(&data, &model);
+#if SFXR_COMPACT_VOICES
+	sfxr_DataSetPhaser(&data, phaser);
+#endif
+
+	int no_samples = sfxr_ComputeRemainingSamples(&data);
+// padd a bit cause some audio players will cut off it samples is too short
+	no_samples = (no_samples + 255) & 0xFFFFFFF0;
+
+	sfxr_Resampler resampler;
+	if(sample_rate != synth_rate)
+		sfxr_ResamplerInit(&resampler, sample_rate, synth_rate, 1);
+
+	float block[SFXR_EXPORT_BLOCK];
+	float resampled[SFXR_EXPORT_BLOCK];
+	int samples = 0;
+
+	for(int remaining = no_samples; remaining > 0; )
+	{
+		int length = remaining < SFXR_EXPORT_BLOCK? remaining : SFXR_EXPORT_BLOCK;
+		int synthesized = sfxr_DataSynthSample(&data, length, block);
+// clear out tail.
+		memset(&block[synthesized], 0, (length-synthesized)*sizeof(float));
+		remaining -= length;
+
+		if(sample_rate == synth_rate)
+		{
+			sink(user, block, length);
+			samples += length;
+			continue;
+		}
+
+// upsampling makes more than it takes, so a block can take several passes
+		for(int read = 0, consumed; read < length; read += consumed)
+		{
+			int written = sfxr_ResamplerRun(&resampler, resampled, SFXR_EXPORT_BLOCK, block + read, length - read, &consumed);
+			sink(user, resampled, written);
+			samples += written;
+		}
+	}
+
+// sfxr_Downsample pads its output with silence, keep doing that
+	if(sample_rate != synth_rate)
+	{
+		int written = sfxr_ResamplerFlush(&resampler, resampled, SFXR_EXPORT_BLOCK);
+		sink(user, resampled, written);
+		samples += written;
+
+		int padding = ((samples + 255) & 0xFFFFFFF0) - samples;
+
+		for(int length; padding > 0; padding -= length, samples += length)
+		{
+			length = padding < SFXR_EXPORT_BLOCK? padding : SFXR_EXPORT_BLOCK;
+			memset(block, 0, length*sizeof(float));
+			sink(user, block, length);
+		}
+	}
+
+	return samples;
+}
+
+#if INCLUDE_SOUND_BANK
+// raw pcm for the bank, which keeps its own header
+
+// quantizes in place and writes
+static void sfxr_WriteBlock(FILE * foutput, float * block, int samples, int wav_bits)
+{
+	sfxr_Quantize(block, block, samples, wav_bits, nullptr);
+	sfxr_PcmToLittleEndian(block, samples, wav_bits);
+	fwrite(block, samples, wav_bits/8, foutput);
+}
+
+struct sfxr_RawSink
+{
+	FILE * foutput;
+	int wav_bits;
+};
+
+static void sfxr_RawSinkWrite(void * user, float * block, int samples)
+{
+	struct sfxr_RawSink * sink = user;
+	sfxr_WriteBlock(sink->foutput, block, samples, sink->wav_bits);
+}
+
+// renders the sound and writes it as raw pcm, returns the number of samples written.
+static int sfxr_WriteSound(FILE * foutput, sfxr_Settings const* s, int wav_bits, int sample_rate)
+{
+	struct sfxr_RawSink sink = { foutput, wav_bits };
+	return sfxr_RenderSound(s, sample_rate, sfxr_RawSinkWrite, &sink);
+}
+#endif
+
+static int sfxr_WavFormatValid(int wav_bits, int sample_rate)
+{
+	return (wav_bits == 8 || wav_bits == 16 || wav_bits == 24 || wav_bits == 32)
+		&& sample_rate > 0 && sample_rate <= SFXR_MAX_SAMPLE_RATE;
+}
+
+// speaker positions for 1 to 8 channels (mono, stereo, 3.0, quad, 5.0, 5.1, 6.1, 7.1)
+static const uint32_t sfxr_ChannelMasks[SFXR_WAV_MAX_CHANNELS] =
+{
+	0x4, 0x3, 0x7, 0x33, 0x37, 0x3F, 0x13F, 0x63F
+};
+
+// builds the header for frames of audio, returns its size.
+// 8 and 16 bit mono/stereo gets the classic pcm header, float gets WAVE_FORMAT_IEEE_FLOAT and a fact chunk,
+// 24 bit or more than 2 channels gets WAVE_FORMAT_EXTENSIBLE.
+static int sfxr_WavHeader(unsigned char * header, int wav_bits, int channels, int sample_rate, uint32_t frames)
+{
+	int is_float	= wav_bits == 32;
+	int extensible	= channels > 2 || wav_bits == 24;
+	int block_align = channels * wav_bits/8;
+	int fmt_size	= extensible? 40 : is_float? 18 : 16;
+	uint32_t data_size = frames * block_align;
+
+	int p = 0;
+	memcpy(header + p, "RIFF", 4);	p += 4;
+	p += 4; // filled in below
+	memcpy(header + p, "WAVE", 4);	p += 4;
+
+	memcpy(header + p, "fmt ", 4);	p += 4;
+	sfxr_PutU32(header + p, fmt_size); p += 4;
+	sfxr_PutU16(header + p, extensible? WAVE_FORMAT_EXTENSIBLE : is_float? WAVE_FORMAT_IEEE_FLOAT : WAVE_FORMAT_UNCOMPRESSED); p += 2;
+	sfxr_PutU16(header + p, channels); p += 2;
+	sfxr_PutU32(header + p, sample_rate); p += 4;
+	sfxr_PutU32(header + p, sample_rate * block_align); p += 4;
+	sfxr_PutU16(header + p, block_align); p += 2;
+	sfxr_PutU16(header + p, wav_bits); p += 2;
+
+	if(fmt_size > 16)
+	{
+		sfxr_PutU16(header + p, fmt_size - 18); p += 2;
+	}
+
+	if(extensible)
+	{
+// valid bits, channel mask, then the sub format guid {000000XX-0000-0010-8000-00AA00389B71}
+		static const unsigned char guid_tail[14] = { 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71 };
+
+		sfxr_PutU16(header + p, wav_bits); p += 2;
+		sfxr_PutU32(header + p, sfxr_ChannelMasks[channels-1]); p += 4;
+		sfxr_PutU16(header + p, is_float? WAVE_FORMAT_IEEE_FLOAT : WAVE_FORMAT_UNCOMPRESSED); p += 2;
+		memcpy(header + p, guid_tail, sizeof(guid_tail)); p += sizeof(guid_tail);
+	}
+
+// everything that isn't plain pcm is supposed to say how many frames it has
+	if(is_float)
+	{
+		memcpy(header + p, "fact", 4);	p += 4;
+		sfxr_PutU32(header + p, 4);		p += 4;
+		sfxr_PutU32(header + p, frames); p += 4;
+	}
+
+	memcpy(header + p, "data", 4);	p += 4;
+	sfxr_PutU32(header + p, data_size); p += 4;
+
+// odd sized chunks are padded to an even size
+	sfxr_PutU32(header + 4, p - 8 + data_size + (data_size & 1));
+	return p;
+}
+
+int sfxr_WavOpen(sfxr_WavWriter * writer, const char * filename, int wav_bits, int channels, int sample_rate)
+{
+	if(writer == nullptr || filename == nullptr) return -1;
+	if(!sfxr_WavFormatValid(wav_bits, sample_rate) || channels < 1 || channels > SFXR_WAV_MAX_CHANNELS)
+		return -1;
+
+	writer->file = fopen(filename, "wb");
+	if(!writer->file)
+		return -1;
+
+	writer->wav_bits	= wav_bits;
+	writer->channels	= channels;
+	writer->sample_rate = sample_rate;
+	writer->frames		= 0;
+
+// written with no frames now and again with the real count on close
+	unsigned char header[SFXR_WAV_HEADER_MAX];
+	fwrite(header, sfxr_WavHeader(header, wav_bits, channels, sample_rate, 0), 1, writer->file);
+
+	return 0;
+}
+
+int sfxr_WavWrite(sfxr_WavWriter * writer, float const* frames, int count)
+{
+	if(writer == nullptr || writer->file == nullptr || (frames == nullptr && count > 0) || count < 0) return -1;
+
+	float block[SFXR_EXPORT_BLOCK];
+	int per_block = SFXR_EXPORT_BLOCK / writer->channels;
+
+	for(int done = 0; done < count; )
+	{
+		int length = count - done < per_block? count - done : per_block;
+		int samples = length * writer->channels;
+
+		sfxr_Quantize(block, frames + done * writer->channels, samples, writer->wav_bits, nullptr);
+		sfxr_PcmToLittleEndian(block, samples, writer->wav_bits);
+		fwrite(block, samples, writer->wav_bits/8, writer->file);
+		done += length;
+	}
+
+	writer->frames += count;
+	return count;
+}
+
+int sfxr_WavClose(sfxr_WavWriter * writer)
+{
+	if(writer == nullptr || writer->file == nullptr) return -1;
+
+	unsigned char header[SFXR_WAV_HEADER_MAX];
+	int size = sfxr_WavHeader(header, writer->wav_bits, writer->channels, writer->sample_rate, writer->frames);
+
+	if((writer->frames * writer->channels * writer->wav_bits/8) & 1)
+		fputc(0, writer->file);
+
+	fseek(writer->file, 0, SEEK_SET);
+	fwrite(header, size, 1, writer->file);
+
+	int result = ferror(writer->file)? -1 : 0;
+	if(fclose(writer->file) != 0) result = -1;
+
+	writer->file = nullptr;
+	return result;
+}
+
+static void sfxr_WavSinkWrite(void * user, float * block, int samples)
+{
+	sfxr_WavWrite(user, block, samples);
+}
+
+struct sfxr_PanSink
+{
+	sfxr_WavWriter * writer;
+	float left;
+	float right;
+};
+
+static void sfxr_PanSinkWrite(void * user, float * block, int samples)
+{
+	struct sfxr_PanSink * sink = user;
+	float stereo[SFXR_EXPORT_BLOCK];
+
+	for(int done = 0; done < samples; )
+	{
+		int length = samples - done < SFXR_EXPORT_BLOCK/2? samples - done : SFXR_EXPORT_BLOCK/2;
+		for(int i = 0; i < length; ++i)
+		{
+			stereo[i*2+0] = block[done+i] * sink->left;
+			stereo[i*2+1] = block[done+i] * sink->right;
+		}
+
+		sfxr_WavWrite(sink->writer, stereo, length);
+		done += length;
+	}
+}
+
+int sfxr_ExportWAV_F(sfxr_Settings const* settings, int wav_bits, int sample_rate,  const char* filename_format, ...)
+{
+	if(wav_bits < 0)	wav_bits = 32;
+	if(sample_rate < 0)  sample_rate = 44100;
+
+	if(!sfxr_WavFormatValid(wav_bits, sample_rate))
+		return -1;
+
+	if(settings == NULL) return -1;
+
+	va_list vlist;
+	va_start(vlist, filename_format);
+	char filename[FILENAME_MAX];
+	int result = vsnprintf(filename, sizeof(filename), filename_format, vlist);
+	va_end(vlist);
+
+	if(result < 0)
+		return result;
+
+	return sfxr_ExportWAV(settings, wav_bits, sample_rate, filename);
+}
+
+int sfxr_ExportWAV(sfxr_Settings const* s, int wav_bits, int sample_rate, const char* filename)
+{
+	if(wav_bits < 0)	wav_bits = 32;
+	if(sample_rate < 0)  sample_rate = 44100;
+
+	if(s == NULL) return -1;
+
+	sfxr_WavWriter writer;
+	if(sfxr_WavOpen(&writer, filename, wav_bits, 1, sample_rate) < 0)
+		return -1;
+
+	sfxr_RenderSound(s, sample_rate, sfxr_WavSinkWrite, &writer);
+	return sfxr_WavClose(&writer);
+}
+
+int sfxr_ExportWAVPanned(sfxr_Settings const* s, int wav_bits, int sample_rate, float pan, const char* filename)
+{
+	if(wav_bits < 0)	wav_bits = 32;
+	if(sample_rate < 0)  sample_rate = 44100;
+
+	if(s == nullptr) return -1;
+
+	sfxr_WavWriter writer;
+	if(sfxr_WavOpen(&writer, filename, wav_bits, 2, sample_rate) < 0)
+		return -1;
+
+// same equal power law as the mixer
+	if(pan < -1.0f) pan = -1.0f;
+	if(pan >  1.0f) pan =  1.0f;
+	float angle = (pan + 1.0f) * 0.25f * 3.14159265358f;
+
+	struct sfxr_PanSink sink = { &writer, cosf(angle), sinf(angle) };
+	sfxr_RenderSound(s, sample_rate, sfxr_PanSinkWrite, &sink);
+	return sfxr_WavClose(&writer);
+}
+
+#if INCLUDE_BATCH_EXPORT
+
+enum
+{
+	SFXR_MAX_THREADS = 64
+};
+
+struct sfxr_BankJob
+{
+	sfxr_Settings const* settings;
+	const char * const* filenames;
+	int count;
+	int wav_bits;
+	int sample_rate;
+
+	int next;
+	int failed;
+};
+
+// workers pull the next sound off a shared counter so long and short sounds balance out
+static void * sfxr_BankWorker(void * arg)
+{
+	struct sfxr_BankJob * job = arg;
+
+	for(;;)
+	{
+		int i = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED);
+		if(i >= job->count)
+			break;
+
+		if(sfxr_ExportWAV(&job->settings[i], job->wav_bits, job->sample_rate, job->filenames[i]) < 0)
+			__atomic_fetch_add(&job->failed, 1, __ATOMIC_RELAXED);
+	}
+
+	return nullptr;
+}
+
+int sfxr_ExportBank(sfxr_Settings const* settings, const char * const* filenames, int count, int wav_bits, int sample_rate, int threads)
+{
+	if(settings == nullptr || filenames == nullptr || count < 0) return -1;
+
+	if(threads <= 0)
+		threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	if(threads > SFXR_MAX_THREADS)	threads = SFXR_MAX_THREADS;
+	if(threads > count)				threads = count;
+	if(threads < 1)					threads = 1;
+
+	struct sfxr_BankJob job = {
+		.settings = settings,
+		.filenames = filenames,
+		.count = count,
+		.wav_bits = wav_bits,
+		.sample_rate = sample_rate,
+		.next = 0,
+		.failed = 0
+	};
+
+// the calling thread is one of the workers
+	pthread_t workers[SFXR_MAX_THREADS];
+	int started = 0;
+
+	for(; started < threads-1; ++started)
+	{
+		if(pthread_create(&workers[started], nullptr, sfxr_BankWorker, &job) != 0)
+			break;
+	}
+
+	sfxr_BankWorker(&job);
+
+	for(int i = 0; i < started; ++i)
+		pthread_join(workers[i], nullptr);
+
+	return job.failed;
+}
+
+#endif
+
+#if INCLUDE_SOUND_BANK
+
+enum
+{
+	SFXR_BANK_VERSION = 1,
+	SFXR_BANK_ALIGN = 64,
+// the file is little endian whatever the host, "SFXB" and three uint32s then the table
+	SFXR_BANK_HEADER_SIZE = 16,
+	SFXR_BANK_ENTRY_SIZE = 32
+};
+
+static void sfxr_PutU64(unsigned char * dst, uint64_t v)
+{
+	sfxr_PutU32(dst, (uint32_t)v); sfxr_PutU32(dst + 4, (uint32_t)(v >> 32));
+}
+
+static uint16_t sfxr_GetU16(unsigned char const* src)
+{
+	return src[0] | (uint16_t)src[1] << 8;
+}
+
+static uint64_t sfxr_GetU64(unsigned char const* src)
+{
+	return sfxr_GetU32(src) | (uint64_t)sfxr_GetU32(src + 4) << 32;
+}
+
+// on a little endian host the table is used straight out of the mapping
+_Static_assert(sizeof(sfxr_BankEntry) == SFXR_BANK_ENTRY_SIZE, "sfxr_BankEntry has to match the file");
+
+static void sfxr_BankPutEntry(unsigned char * dst, sfxr_BankEntry const* entry)
+{
+	sfxr_PutU64(dst,	  entry->name_hash);
+	sfxr_PutU64(dst + 8,  entry->offset);
+	sfxr_PutU32(dst + 16, entry->length);
+	sfxr_PutU16(dst + 20, entry->bits);
+	sfxr_PutU16(dst + 22, entry->channels);
+	sfxr_PutU32(dst + 24, entry->sample_rate);
+	sfxr_PutU32(dst + 28, entry->reserved);
+}
+
+static void sfxr_BankGetEntry(sfxr_BankEntry * entry, unsigned char const* src)
+{
+	entry->name_hash   = sfxr_GetU64(src);
+	entry->offset	   = sfxr_GetU64(src + 8);
+	entry->length	   = sfxr_GetU32(src + 16);
+	entry->bits		   = sfxr_GetU16(src + 20);
+	entry->channels	   = sfxr_GetU16(src + 22);
+	entry->sample_rate = sfxr_GetU32(src + 24);
+	entry->reserved	   = sfxr_GetU32(src + 28);
+}
+
+unsigned long long sfxr_BankHash(const char * name)
+{
+	unsigned long long hash = 0xcbf29ce484222325ull;
+	for(; *name; ++name)
+	{
+		hash ^= (unsigned char)*name;
+		hash *= 0x100000001b3ull;
+	}
+	return hash;
+}
+
+static int sfxr_BankEntryCompare(void const* a, void const* b)
+{
+	uint64_t x = sfxr_GetU64(a);
+	uint64_t y = sfxr_GetU64(b);
+	return x < y? -1 : x > y;
+}
+
+int sfxr_WriteBank(const char * filename, sfxr_Settings const* settings, const char * const* names, int count, int wav_bits, int sample_rate)
+{
+	if(wav_bits < 0)	wav_bits = 32;
+	if(sample_rate < 0)  sample_rate = 44100;
+
+	if(!sfxr_WavFormatValid(wav_bits, sample_rate))
+		return -1;
+
+	if(filename == nullptr || settings == nullptr || names == nullptr || count < 0) return -1;
+
+	FILE* foutput= fopen(filename, "wb+");
+	if(!foutput)
+		return -1;
+
+	unsigned char header[SFXR_BANK_HEADER_SIZE];
+	memcpy(header, "SFXB", 4);
+	sfxr_PutU32(header + 4, SFXR_BANK_VERSION);
+	sfxr_PutU32(header + 8, count);
+	sfxr_PutU32(header + 12, SFXR_BANK_ENTRY_SIZE);
+	fwrite(header, sizeof(header), 1, foutput);
+
+// reserve the table, it gets filled in as the sounds are written
+	sfxr_BankEntry entry;
+	unsigned char bytes[SFXR_BANK_ENTRY_SIZE];
+	memset(&entry, 0, sizeof(entry));
+	memset(bytes, 0, sizeof(bytes));
+	for(int i = 0; i < count; ++i)
+		fwrite(bytes, sizeof(bytes), 1, foutput);
+
+	static const char padding[SFXR_BANK_ALIGN];
+
+	for(int i = 0; i < count; ++i)
+	{
+		long position = ftell(foutput);
+		long aligned = (position + SFXR_BANK_ALIGN-1) & ~(long)(SFXR_BANK_ALIGN-1);
+		fwrite(padding, 1, aligned - position, foutput);
+
+		int samples = sfxr_WriteSound(foutput, &settings[i], wav_bits, sample_rate);
+
+		entry.name_hash	  = sfxr_BankHash(names[i]);
+		entry.offset	  = aligned;
+		entry.length	  = samples*wav_bits/8;
+		entry.bits		  = wav_bits;
+		entry.channels	  = 1;
+		entry.sample_rate = sample_rate;
+
+		sfxr_BankPutEntry(bytes, &entry);
+		fseek(foutput, SFXR_BANK_HEADER_SIZE + i*SFXR_BANK_ENTRY_SIZE, SEEK_SET);
+		fwrite(bytes, sizeof(bytes), 1, foutput);
+		fseek(foutput, 0, SEEK_END);
+	}
+
+	if(fflush(foutput) != 0 || ferror(foutput))
+	{
+		fclose(foutput);
+		return -1;
+	}
+
+// sort the table in place through a mapping rather than holding it in memory
+	size_t table_end = SFXR_BANK_HEADER_SIZE + (size_t)count*SFXR_BANK_ENTRY_SIZE;
+	int duplicates = 0;
+	if(count > 1)
+	{
+		void * mapping = mmap(nullptr, table_end, PROT_READ|PROT_WRITE, MAP_SHARED, fileno(foutput), 0);
+		if(mapping == MAP_FAILED)
+		{
+			fclose(foutput);
+			return -1;
+		}
+
+		unsigned char * table = (unsigned char*)mapping + SFXR_BANK_HEADER_SIZE;
+		qsort(table, count, SFXR_BANK_ENTRY_SIZE, sfxr_BankEntryCompare);
+
+// sfxr_BankFind could only ever return one of two names with the same hash
+		for(int i = 1; i < count && !duplicates; ++i)
+			duplicates = sfxr_BankEntryCompare(table + (i-1)*SFXR_BANK_ENTRY_SIZE, table + i*SFXR_BANK_ENTRY_SIZE) == 0;
+
+		munmap(mapping, table_end);
+	}
+
+	fclose(foutput);
+
+	if(duplicates)
+	{
+		remove(filename);
+		return -1;
+	}
+
+	return 0;
+}
+
+int sfxr_BankOpen(sfxr_Bank * bank, const char * filename)
+{
+	if(bank == nullptr || filename == nullptr) return -1;
+	memset(bank, 0, sizeof(*bank));
+
+	int fd = open(filename, O_RDONLY);
+	if(fd < 0) return -1;
+
+	struct stat info;
+	if(fstat(fd, &info) != 0 || (size_t)info.st_size < SFXR_BANK_HEADER_SIZE)
+	{
+		close(fd);
+		return -1;
+	}
+
+// a big endian host decodes the table in place, a private mapping only copies the pages of the table
+	int decode = !sfxr_HostLittleEndian();
+	void * mapping = mmap(nullptr, info.st_size, decode? PROT_READ|PROT_WRITE : PROT_READ, decode? MAP_PRIVATE : MAP_SHARED, fd, 0);
+// the mapping keeps the file alive
+	close(fd);
+
+	if(mapping == MAP_FAILED)
+		return -1;
+
+	unsigned char * bytes = mapping;
+	unsigned long long size = info.st_size;
+	uint32_t count = sfxr_GetU32(bytes + 8);
+
+	if(memcmp(bytes, "SFXB", 4) != 0
+	|| sfxr_GetU32(bytes + 4) != SFXR_BANK_VERSION
+	|| sfxr_GetU32(bytes + 12) != SFXR_BANK_ENTRY_SIZE
+	|| count > INT_MAX
+	|| SFXR_BANK_HEADER_SIZE + (unsigned long long)count*SFXR_BANK_ENTRY_SIZE > size)
+	{
+		munmap(mapping, size);
+		return -1;
+	}
+
+	for(uint32_t i = 0; i < count; ++i)
+	{
+		sfxr_BankEntry entry;
+		unsigned char * src = bytes + SFXR_BANK_HEADER_SIZE + (size_t)i*SFXR_BANK_ENTRY_SIZE;
+		sfxr_BankGetEntry(&entry, src);
+
+		if(entry.offset > size || entry.length > size - entry.offset)
+		{
+			munmap(mapping, size);
+			return -1;
+		}
+
+		if(decode)
+			memcpy(src, &entry, sizeof(entry));
+	}
+
+	bank->mapping = mapping;
+	bank->size	  = size;
+	bank->entries = (sfxr_BankEntry const*)(bytes + SFXR_BANK_HEADER_SIZE);
+	bank->count	  = count;
+
+	return 0;
+}
+
+void sfxr_BankClose(sfxr_Bank * bank)
+{
+	if(bank == nullptr || bank->mapping == nullptr) return;
+
+	munmap((void*)bank->mapping, bank->size);
+	memset(bank, 0, sizeof(*bank));
+}
+
+sfxr_BankEntry const* sfxr_BankFind(sfxr_Bank const* bank, const char * name)
+{
+	if(bank == nullptr || bank->entries == nullptr || name == nullptr) return nullptr;
+
+	unsigned long long hash = sfxr_BankHash(name);
+	int lo = 0, hi = bank->count;
+
+	while(lo < hi)
+	{
+		int mid = lo + (hi - lo) / 2;
+		if(bank->entries[mid].name_hash < hash)
+			lo = mid+1;
+		else
+			hi = mid;
+	}
+
+	return lo < bank->count && bank->entries[lo].name_hash == hash? &bank->entries[lo] : nullptr;
+}
+
+void const* sfxr_BankSamples(sfxr_Bank const* bank, sfxr_BankEntry const* entry)
+{
+	if(bank == nullptr || bank->mapping == nullptr || entry == nullptr) return nullptr;
+	return (char const*)bank->mapping + entry->offset;
+}
+
+#endif
+
+#endif
+
+#if INCLUDE_RENDER_CACHE
+
+int sfxr_CacheInit(sfxr_Cache * cache, float * arena, int arena_length, sfxr_CacheEntry * entries, int max_entries)
+{
+	if(cache == nullptr || arena == nullptr || entries == nullptr || arena_length <= 0 || max_entries <= 0) return -1;
+
+	memset(cache, 0, sizeof(*cache));
+	cache->arena		= arena;
+	cache->arena_length = arena_length;
+	cache->entries		= entries;
+	cache->max_entries	= max_entries;
+
+	return 0;
+}
+
+static unsigned long long sfxr_CacheHash(sfxr_Settings const* settings, int sample_rate)
+{
+	unsigned char const* bytes = (unsigned char const*)settings;
+	unsigned long long hash = 0xcbf29ce484222325ull ^ (unsigned int)sample_rate;
+
+	for(size_t i = 0; i < sizeof(*settings); ++i)
+	{
+		hash ^= bytes[i];
+		hash *= 0x100000001b3ull;
+	}
+
+	return hash;
+}
+
+// every entry holds at least one float of the arena, even a silent sound,
+// so no two entries share an offset and sfxr_CacheRelease can tell them apart by pointer.
+static int sfxr_CacheSpan(sfxr_CacheEntry const* entry)
+{
+	return entry->length > 0? entry->length : 1;
+}
+
+// first gap in the arena at least length long, the entries aren't kept in order so every end is a candidate.
+static int sfxr_CacheFindSpace(sfxr_Cache const* cache, int length)
+{
+	for(int c = -1; c < cache->count; ++c)
+	{
+		int start = c < 0? 0 : cache->entries[c].offset + sfxr_CacheSpan(&cache->entries[c]);
+		if(start + length > cache->arena_length)
+			continue;
+
+		int fits = 1;
+		for(int e = 0; e < cache->count && fits; ++e)
+		{
+			sfxr_CacheEntry const* entry = &cache->entries[e];
+			fits = entry->offset >= start + length || entry->offset + sfxr_CacheSpan(entry) <= start;
+		}
+
+		if(fits) return start;
+	}
+
+	return -1;
+}
+
+static int sfxr_CacheEvict(sfxr_Cache * cache)
+{
+	int oldest = -1;
+	for(int e = 0; e < cache->count; ++e)
+	{
+		if(cache->entries[e].refs == 0
+		&& (oldest < 0 || cache->entries[e].last_used < cache->entries[oldest].last_used))
+			oldest = e;
+	}
+
+	if(oldest < 0) return -1;
+
+	cache->entries[oldest] = cache->entries[--cache->count];
+	cache->evictions += 1;
+	return 0;
+}
+
+float const* sfxr_CacheRender(sfxr_Cache * cache, sfxr_Settings const* settings, int sample_rate, int * length)
+{
+	if(cache == nullptr || settings == nullptr || length == nullptr) return nullptr;
+	if(sample_rate < 0)  sample_rate = SAMPLE_RATE;
+	if(sample_rate > SFXR_MAX_SAMPLE_RATE || sample_rate == 0) return nullptr;
+
+	unsigned long long hash = sfxr_CacheHash(settings, sample_rate);
+
+	for(int e = 0; e < cache->count; ++e)
+	{
+		sfxr_CacheEntry * entry = &cache->entries[e];
+		if(entry->hash != hash || entry->sample_rate != sample_rate
+		|| memcmp(&entry->settings, settings, sizeof(*settings)) != 0)
+			continue;
+
+		entry->last_used = ++cache->clock;
+		entry->refs		+= 1;
+		cache->hits		+= 1;
+
+		*length = entry->length;
+		return cache->arena + entry->offset;
+	}
+
+	cache->misses += 1;
+
+	sfxr_Model model;
+	sfxr_Data  data;
+#if SFXR_COMPACT_VOICES
+	float phaser[SFXR_PHASER_LENGTH];
+#endif
+
+// synthesized at sample_rate up to 44100, only higher rates are resampled
+	int synth_rate = sample_rate < SAMPLE_RATE? sample_rate : SAMPLE_RATE;
+	sfxr_ModelInitRate(&model, settings, synth_rate);
+	sfxr_DataInit(&data, &model);
+#if SFXR_COMPACT_VOICES
+	sfxr_DataSetPhaser(&data, phaser);
+#endif
+
+	int samples = sfxr_ComputeRemainingSamples(&data);
+	if(samples < 0)
+		return nullptr;
+
+	sfxr_Resampler resampler;
+	if(sample_rate != synth_rate)
+		sfxr_ResamplerInit(&resampler, sample_rate, synth_rate, 1);
+
+// when upsampling the sound is rendered far enough into the space that the output never catches up with it
+	int resampled = sample_rate != synth_rate? sfxr_ResamplerOutputLength(&resampler, samples) : samples;
+	int shift = resampled > samples? resampled - samples + SFXR_RESAMPLER_TAPS : 0;
+	int space = samples + shift > 0? samples + shift : 1;
+
+	if(space > cache->arena_length)
+		return nullptr;
+
+	int offset;
+	while(cache->count == cache->max_entries || (offset = sfxr_CacheFindSpace(cache, space)) < 0)
+	{
+		if(sfxr_CacheEvict(cache) < 0)
+			return nullptr;
+	}
+
+// rendered and resampled in place, then the entry shrinks to fit
+	float * buffer = cache->arena + offset;
+	samples = sfxr_DataSynthSample(&data, samples, buffer + shift);
+
+	if(sample_rate != synth_rate)
+	{
+		int written = sfxr_ResamplerRun(&resampler, buffer, space, buffer + shift, samples, nullptr);
+		samples = written + sfxr_ResamplerFlush(&resampler, buffer + written, space - written);
+	}
+
+	sfxr_CacheEntry * entry = &cache->entries[cache->count++];
+	entry->settings	   = *settings;
+	entry->hash		   = hash;
+	entry->last_used   = ++cache->clock;
+	entry->sample_rate = sample_rate;
+	entry->offset	   = offset;
+	entry->length	   = samples;
+	entry->refs		   = 1;
+
+	*length = samples;
+	return buffer;
+}
+
+int sfxr_CacheRelease(sfxr_Cache * cache, float const* samples)
+{
+	if(cache == nullptr || samples == nullptr) return -1;
+
+	for(int e = 0; e < cache->count; ++e)
+	{
+		sfxr_CacheEntry * entry = &cache->entries[e];
+		if(cache->arena + entry->offset == samples && entry->refs > 0)
+		{
+			entry->refs -= 1;
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
+#endif
+
+#if INCLUDE_MIXER
+
+enum
+{
+	SFXR_MIXER_BLOCK = 256
+};
+
+int sfxr_MixerInit(sfxr_Mixer * mixer, enum sfxr_StealPolicy policy)
+{
+	if(mixer == nullptr) return -1;
+
+	memset(mixer, 0, sizeof(*mixer));
+	mixer->policy = policy;
+	mixer->output_rate = SAMPLE_RATE;
+#if SFXR_COMPACT_VOICES
+	sfxr_PhaserPoolInit(&mixer->phaser_pool, mixer->phasers, SFXR_MIXER_PHASERS);
+#else
+	sfxr_PhaserPoolInit(&mixer->phaser_pool, nullptr, 0);
+#endif
+
+	return 0;
+}
+
+static sfxr_MixerVoice * sfxr_MixerFind(sfxr_Mixer * mixer, int handle)
+{
+	if(mixer == nullptr || handle < 0) return nullptr;
+
+	for(int v = 0; v < SFXR_MIXER_VOICES; ++v)
+	{
+		if(mixer->voices[v].active && mixer->voices[v].handle == handle)
+			return &mixer->voices[v];
+	}
+
+	return nullptr;
+}
+
+// constant power pan, worked out once here rather than per sample
+static void sfxr_MixerPan(sfxr_MixerVoice * voice, float gain, float pan)
+{
+	if(pan < -1.0f) pan = -1.0f;
+	if(pan >  1.0f) pan =  1.0f;
+
+	float angle = (pan + 1.0f) * 0.25f * 3.14159265358f;
+
+	voice->gain	 = gain;
+	voice->pan	 = pan;
+	voice->left	 = gain * cosf(angle);
+	voice->right = gain * sinf(angle);
+}
+
+static sfxr_MixerVoice * sfxr_MixerAllocate(sfxr_Mixer * mixer)
+{
+	sfxr_MixerVoice * oldest = nullptr;
+
+	for(int v = 0; v < SFXR_MIXER_VOICES; ++v)
+	{
+		sfxr_MixerVoice * voice = &mixer->voices[v];
+		if(!voice->active)
+			return voice;
+
+		if(oldest == nullptr || voice->started < oldest->started)
+			oldest = voice;
+	}
+
+	if(mixer->policy != sfxr_StealOldest)
+	{
+		mixer->rejected += 1;
+		return nullptr;
+	}
+
+	mixer->steals += 1;
+	return oldest;
+}
+
+// handles made by the mixer and by queues come from separate ranges, and every queue attached to
+// the mixer gets its own range above SFXR_QUEUE_SHIFT, so a handle names one voice of one producer
+enum
+{
+	SFXR_MIXER_HANDLES = 0x3FFFFFFF,
+	SFXR_QUEUE_HANDLES = 0x40000000,
+	SFXR_QUEUE_SHIFT   = 27,
+	SFXR_QUEUE_COUNTER = (1 << SFXR_QUEUE_SHIFT) - 1
+};
+
+_Static_assert(SFXR_MIXER_QUEUES <= 1 << (30 - SFXR_QUEUE_SHIFT), "queue index doesn't fit in a handle");
+
+// scales the frequency by pitch, the limit moves with it so a slide stops at the same interval
+static void sfxr_ModelTranspose(sfxr_Model * model, float pitch)
+{
+	if(pitch == 1.0f || !(pitch > 0.0f)) return;
+
+	double base = pitch*(model->frequency.base*model->frequency.base+0.001)-0.001;
+	model->frequency.base = base > 0? sqrt(base) : 0.0f;
+	model->fmaxperiod /= pitch;
+}
+
+static int sfxr_MixerStart(sfxr_Mixer * mixer, sfxr_Model const* model, float gain, float pan, float pitch, int handle)
+{
+	sfxr_MixerVoice * voice = sfxr_MixerAllocate(mixer);
+	if(voice == nullptr) return -1;
+
+// a stolen voice gives its delay line back before sfxr_DataInit forgets it
+	sfxr_DataReleasePhaser(&voice->data, &mixer->phaser_pool);
+	voice->model = *model;
+	sfxr_DataInit(&voice->data, &voice->model);
+// a noise generator of its own, so noise voices playing together don't cancel and reinforce
+	sfxr_DataSeed(&voice->data, (unsigned int)handle);
+	sfxr_DataTakePhaser(&voice->data, &mixer->phaser_pool);
+	sfxr_MixerPan(voice, gain, pan);
+
+	voice->pitch   = pitch;
+	voice->started = ++mixer->clock;
+	voice->handle  = handle;
+	voice->active  = 1;
+
+	mixer->triggers += 1;
+
+	return voice->handle;
+}
+
+int sfxr_MixerTriggerModel(sfxr_Mixer * mixer, sfxr_Model const* model, float gain, float pan)
+{
+	if(mixer == nullptr || model == nullptr) return -1;
+
+	int handle = sfxr_MixerStart(mixer, model, gain, pan, 1.0f, mixer->next_handle);
+	if(handle >= 0)
+		mixer->next_handle = (mixer->next_handle + 1) & SFXR_MIXER_HANDLES;
+
+	return handle;
+}
+
+int sfxr_MixerTrigger(sfxr_Mixer * mixer, sfxr_Settings const* settings, float gain, float pan)
+{
+	if(mixer == nullptr || settings == nullptr) return -1;
+
+	sfxr_Model model;
+	if(sfxr_ModelInit(&model, settings) < 0)
+		return -1;
+
+	return sfxr_MixerTriggerModel(mixer, &model, gain, pan);
+}
+
+int sfxr_MixerSetVoice(sfxr_Mixer * mixer, int handle, float gain, float pan)
+{
+	sfxr_MixerVoice * voice = sfxr_MixerFind(mixer, handle);
+	if(voice == nullptr) return -1;
+
+	sfxr_MixerPan(voice, gain, pan);
+	return 0;
+}
+
+int sfxr_MixerUpdateModel(sfxr_Mixer * mixer, int handle, sfxr_Model const* model, unsigned int groups)
+{
+	if(model == nullptr) return -1;
+
+	sfxr_MixerVoice * voice = sfxr_MixerFind(mixer, handle);
+	if(voice == nullptr) return -1;
+
+	voice->model = *model;
+	sfxr_ModelTranspose(&voice->model, voice->pitch);
+	if(sfxr_DataUpdate(&voice->data, groups) < 0)
+		return -1;
+
+// the update may have turned the flanger on
+	sfxr_DataTakePhaser(&voice->data, &mixer->phaser_pool);
+	return 0;
+}
+
+int sfxr_MixerUpdate(sfxr_Mixer * mixer, int handle, sfxr_Settings const* settings, unsigned int groups)
+{
+	if(mixer == nullptr || settings == nullptr) return -1;
+
+	sfxr_Model model;
+	if(sfxr_ModelInit(&model, settings) < 0)
+		return -1;
+
+	return sfxr_MixerUpdateModel(mixer, handle, &model, groups);
+}
+
+int sfxr_MixerStop(sfxr_Mixer * mixer, int handle)
+{
+	sfxr_MixerVoice * voice = sfxr_MixerFind(mixer, handle);
+	if(voice == nullptr) return -1;
+
+	sfxr_DataReleasePhaser(&voice->data, &mixer->phaser_pool);
+	voice->active = 0;
+	return 0;
+}
+
+int sfxr_MixerActiveVoices(sfxr_Mixer const* mixer)
+{
+	if(mixer == nullptr) return -1;
+
+	int count = 0;
+	for(int v = 0; v < SFXR_MIXER_VOICES; ++v)
+		count += mixer->voices[v].active != 0;
+
+	return count;
+}
+
+int sfxr_QueueInit(sfxr_CommandQueue * queue)
+{
+	if(queue == nullptr) return -1;
+
+	memset(queue, 0, sizeof(*queue));
+	queue->handle_base = SFXR_QUEUE_HANDLES;
+
+	return 0;
+}
+
+// reserves the next slot, or null if the consumer hasn't caught up
+static sfxr_Command * sfxr_QueueReserve(sfxr_CommandQueue * queue)
+{
+	unsigned int head = __atomic_load_n(&queue->head, __ATOMIC_RELAXED);
+	unsigned int tail = __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+
+	if(head - tail >= SFXR_QUEUE_LENGTH)
+	{
+		queue->dropped += 1;
+		return nullptr;
+	}
+
+	return &queue->commands[head & (SFXR_QUEUE_LENGTH-1)];
+}
+
+static void sfxr_QueuePublish(sfxr_CommandQueue * queue)
+{
+	__atomic_store_n(&queue->head, queue->head + 1, __ATOMIC_RELEASE);
+}
+
+int sfxr_QueueTriggerModel(sfxr_CommandQueue * queue, sfxr_Model const* model, float gain, float pan, float pitch)
+{
+	if(queue == nullptr || model == nullptr) return -1;
+
+	sfxr_Command * command = sfxr_QueueReserve(queue);
+	if(command == nullptr) return -1;
+
+	command->type	= sfxr_CommandTrigger;
+	command->handle = queue->handle_base | queue->next_handle;
+	command->gain	= gain;
+	command->pan	= pan;
+	command->pitch	= pitch;
+	command->model	= *model;
+	sfxr_ModelTranspose(&command->model, pitch);
+
+	queue->next_handle = (queue->next_handle + 1) & SFXR_QUEUE_COUNTER;
+
+	sfxr_QueuePublish(queue);
+	return command->handle;
+}
+
+int sfxr_QueueTrigger(sfxr_CommandQueue * queue, sfxr_Settings const* settings, float gain, float pan, float pitch)
+{
+	if(queue == nullptr || settings == nullptr) return -1;
+
+	sfxr_Model model;
+	if(sfxr_ModelInit(&model, settings) < 0)
+		return -1;
+
+	return sfxr_QueueTriggerModel(queue, &model, gain, pan, pitch);
+}
+
+int sfxr_QueueStop(sfxr_CommandQueue * queue, int handle)
+{
+	if(queue == nullptr) return -1;
+
+	sfxr_Command * command = sfxr_QueueReserve(queue);
+	if(command == nullptr) return -1;
+
+	command->type	= sfxr_CommandStop;
+	command->handle = handle;
+
+	sfxr_QueuePublish(queue);
+	return 0;
+}
+
+int sfxr_QueueSetVoice(sfxr_CommandQueue * queue, int handle, float gain, float pan)
+{
+	if(queue == nullptr) return -1;
+
+	sfxr_Command * command = sfxr_QueueReserve(queue);
+	if(command == nullptr) return -1;
+
+	command->type	= sfxr_CommandSetVoice;
+	command->handle = handle;
+	command->gain	= gain;
+	command->pan	= pan;
+
+	sfxr_QueuePublish(queue);
+	return 0;
+}
+
+// the model goes as it is, the mixer transposes it like the voice it updates
+int sfxr_QueueUpdateModel(sfxr_CommandQueue * queue, int handle, sfxr_Model const* model, unsigned int groups)
+{
+	if(queue == nullptr || model == nullptr) return -1;
+
+	sfxr_Command * command = sfxr_QueueReserve(queue);
+	if(command == nullptr) return -1;
+
+	command->type	= sfxr_CommandUpdate;
+	command->handle = handle;
+	command->groups = groups;
+	command->model	= *model;
+
+	sfxr_QueuePublish(queue);
+	return 0;
+}
+
+int sfxr_QueueUpdate(sfxr_CommandQueue * queue, int handle, sfxr_Settings const* settings, unsigned int groups)
+{
+	if(queue == nullptr || settings == nullptr) return -1;
+
+	sfxr_Model model;
+	if(sfxr_ModelInit(&model, settings) < 0)
+		return -1;
+
+	return sfxr_QueueUpdateModel(queue, handle, &model, groups);
+}
+
+int sfxr_MixerAttach(sfxr_Mixer * mixer, sfxr_CommandQueue * queue)
+{
+	if(mixer == nullptr || queue == nullptr || mixer->queue_count == SFXR_MIXER_QUEUES) return -1;
+
+	queue->handle_base = SFXR_QUEUE_HANDLES | mixer->queue_count << SFXR_QUEUE_SHIFT;
+	mixer->queues[mixer->queue_count++] = queue;
+	return 0;
+}
+
+int sfxr_MixerDrain(sfxr_Mixer * mixer, sfxr_CommandQueue * queue)
+{
+	if(mixer == nullptr || queue == nullptr) return -1;
+
+	unsigned int tail = __atomic_load_n(&queue->tail, __ATOMIC_RELAXED);
+	unsigned int head = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+	int count = 0;
+
+	for(; tail != head; ++tail, ++count)
+	{
+		sfxr_Command const* command = &queue->commands[tail & (SFXR_QUEUE_LENGTH-1)];
+
+		switch(command->type)
+		{
+		case sfxr_CommandTrigger:
+			sfxr_MixerStart(mixer, &command->model, command->gain, command->pan, command->pitch, command->handle);
+			break;
+		case sfxr_CommandStop:
+			sfxr_MixerStop(mixer, command->handle);
+			break;
+		case sfxr_CommandSetVoice:
+			sfxr_MixerSetVoice(mixer, command->handle, command->gain, command->pan);
+			break;
+		case sfxr_CommandUpdate:
+			sfxr_MixerUpdateModel(mixer, command->handle, &command->model, command->groups);
+			break;
+		default:
+			break;
+		}
+	}
+
+	__atomic_store_n(&queue->tail, tail, __ATOMIC_RELEASE);
+	return count;
+}
+
+// mixes frames at 44100 into out
+static void sfxr_MixerRender(sfxr_Mixer * mixer, float * out, int frames)
+{
+	memset(out, 0, frames * 2 * sizeof(float));
+
+	SFXR_ALIGNED float scratch[SFXR_MIXER_VOICES][SFXR_MIXER_BLOCK];
+	sfxr_Data * data[SFXR_MIXER_VOICES];
+	float * buffers[SFXR_MIXER_VOICES];
+	sfxr_MixerVoice * playing[SFXR_MIXER_VOICES];
+	int written[SFXR_MIXER_VOICES];
+
+// all active voices go through the multi voice renderer a block at a time
+	for(int offset = 0; offset < frames; offset += SFXR_MIXER_BLOCK)
+	{
+		int length = frames - offset < SFXR_MIXER_BLOCK? frames - offset : SFXR_MIXER_BLOCK;
+		int count = 0;
+
+		for(int q = 0; q < mixer->queue_count; ++q)
+			sfxr_MixerDrain(mixer, mixer->queues[q]);
+
+		for(int v = 0; v < SFXR_MIXER_VOICES; ++v)
+		{
+			if(!mixer->voices[v].active) continue;
+
+			playing[count] = &mixer->voices[v];
+			data[count]	   = &mixer->voices[v].data;
+			buffers[count] = scratch[count];
+			++count;
+		}
+
+		if(count == 0 && mixer->queue_count == 0)
+			break;
+
+		sfxr_DataSynthSampleMulti(data, count, length, buffers, written);
+
+		float * dst = out + offset*2;
+		for(int c = 0; c < count; ++c)
+		{
+			float left = playing[c]->left, right = playing[c]->right;
+			float const* src = scratch[c];
+
+			for(int i = 0; i < written[c]; ++i)
+			{
+				dst[i*2+0] += src[i] * left;
+				dst[i*2+1] += src[i] * right;
+			}
+
+			if(written[c] < length)
+			{
+				sfxr_DataReleasePhaser(&playing[c]->data, &mixer->phaser_pool);
+				playing[c]->active = 0;
+			}
+		}
+	}
+}
+
+int sfxr_MixerSetOutputRate(sfxr_Mixer * mixer, int sample_rate)
+{
+	if(mixer == nullptr) return -1;
+
+	if(sample_rate != SAMPLE_RATE && sfxr_ResamplerInit(&mixer->resampler, sample_rate, SAMPLE_RATE, 2) < 0)
+		return -1;
+
+	mixer->output_rate = sample_rate;
+	return 0;
+}
+
+int sfxr_MixerMix(sfxr_Mixer * mixer, float * out, int frames)
+{
+	if(mixer == nullptr || out == nullptr || frames < 0) return -1;
+
+	if(mixer->output_rate == SAMPLE_RATE)
+	{
+		sfxr_MixerRender(mixer, out, frames);
+		return frames;
+	}
+
+// render just as much as the resampler needs to fill out, a block at a time
+	float block[2*SFXR_MIXER_BLOCK];
+
+	for(int written = 0; written < frames; )
+	{
+		int needed = sfxr_ResamplerInputNeeded(&mixer->resampler, frames - written);
+		int length = needed < SFXR_MIXER_BLOCK? needed : SFXR_MIXER_BLOCK;
+
+		sfxr_MixerRender(mixer, block, length);
+		written += sfxr_ResamplerRun(&mixer->resampler, out + written*2, frames - written, block, length, nullptr);
+	}
+
+	return frames;
+}
+
+#endif
+
+#if INCLUDE_SEQUENCER
+
+enum
+{
+	SFXR_SEQUENCER_BLOCK = 256,
+	SFXR_SONG_BLOCK = 1024
+};
+
+int sfxr_SequencerInit(sfxr_Sequencer * sequencer, int sample_rate, double ticks_per_second)
+{
+	if(sequencer == nullptr || sample_rate <= 0 || sample_rate > SFXR_MAX_SAMPLE_RATE) return -1;
+
+	memset(sequencer, 0, sizeof(*sequencer));
+	sequencer->sample_rate = sample_rate;
+#if SFXR_COMPACT_VOICES
+	sfxr_PhaserPoolInit(&sequencer->phaser_pool, sequencer->phasers, SFXR_SEQUENCER_PHASERS);
+#else
+	sfxr_PhaserPoolInit(&sequencer->phaser_pool, nullptr, 0);
+#endif
+
+	for(int c = 0; c < SFXR_SEQUENCER_CHANNELS; ++c)
+		sequencer->channel_gain[c] = 1.0f;
+
+	return sfxr_SequencerSetTempo(sequencer, ticks_per_second);
+}
+
+int sfxr_SequencerSetInstrument(sfxr_Sequencer * sequencer, int instrument, sfxr_Settings const* settings)
+{
+	if(sequencer == nullptr || settings == nullptr || instrument < 0 || instrument >= SFXR_SEQUENCER_INSTRUMENTS) return -1;
+
+	if(sfxr_ModelInitRate(&sequencer->instruments[instrument], settings, sequencer->sample_rate) < 0)
+		return -1;
+
+	sequencer->loaded[instrument] = 1;
+	return 0;
+}
+
+int sfxr_SequencerSetInstrumentModel(sfxr_Sequencer * sequencer, int instrument, sfxr_Model const* model)
+{
+	if(sequencer == nullptr || model == nullptr || instrument < 0 || instrument >= SFXR_SEQUENCER_INSTRUMENTS) return -1;
+	if(model->sample_rate != sequencer->sample_rate) return -1;
+
+	sequencer->instruments[instrument] = *model;
+	sequencer->loaded[instrument] = 1;
+	return 0;
+}
+
+int sfxr_SequencerSetChannel(sfxr_Sequencer * sequencer, int channel, float gain, float pan)
+{
+	if(sequencer == nullptr || channel < 0 || channel >= SFXR_SEQUENCER_CHANNELS) return -1;
+
+	sequencer->channel_gain[channel] = gain;
+	sequencer->channel_pan[channel]	 = pan < -1.0f? -1.0f : pan > 1.0f? 1.0f : pan;
+	return 0;
+}
+
+int sfxr_SequencerSetTempo(sfxr_Sequencer * sequencer, double ticks_per_second)
+{
+	if(sequencer == nullptr || !(ticks_per_second > 0)) return -1;
+
+	if(sequencer->samples_per_tick > 0)
+		sequencer->tempo_tick += (sequencer->position - sequencer->tempo_sample) / sequencer->samples_per_tick;
+
+	sequencer->tempo_sample		= sequencer->position;
+	sequencer->samples_per_tick = sequencer->sample_rate / ticks_per_second;
+	return 0;
+}
+
+static unsigned long long sfxr_SequencerSampleOf(sfxr_Sequencer const* sequencer, unsigned int tick)
+{
+	double offset = floor((tick - sequencer->tempo_tick) * sequencer->samples_per_tick + 0.5);
+	return offset > 0? sequencer->tempo_sample + (unsigned long long)offset : sequencer->tempo_sample;
+}
+
+static void sfxr_SequencerMix(float * dst, float const* src, int length, float left, float right)
+{
+	for(int i = 0; i < length; ++i)
+	{
+		dst[i*2+0] += src[i] * left;
+		dst[i*2+1] += src[i] * right;
+	}
+}
+
+// plays voice up to sample to of the block at out
+static void sfxr_SequencerAdvance(sfxr_Sequencer * sequencer, sfxr_SequencerVoice * voice, float * out, int to)
+{
+	if(!voice->active || voice->rendered >= to) return;
+
+	float block[SFXR_SEQUENCER_BLOCK];
+	int length	= to - voice->rendered;
+	int written = sfxr_DataSynthSample(&voice->data, length, block);
+
+	sfxr_SequencerMix(out + voice->rendered*2, block, written, voice->left, voice->right);
+	voice->rendered = to;
+
+	if(written < length)
+	{
+		sfxr_DataReleasePhaser(&voice->data, &sequencer->phaser_pool);
+		voice->active = 0;
+	}
+}
+
+// a free voice, or else the oldest released one, or else the oldest
+static sfxr_SequencerVoice * sfxr_SequencerAllocate(sfxr_Sequencer * sequencer, float * out, int at)
+{
+	sfxr_SequencerVoice * victim = nullptr;
+
+	for(int v = 0; v < SFXR_SEQUENCER_VOICES; ++v)
+	{
+		sfxr_SequencerVoice * voice = &sequencer->voices[v];
+		if(!voice->active)
+			return voice;
+
+		if(victim == nullptr
+		|| (victim->data.held && !voice->data.held)
+		|| (victim->data.held == voice->data.held && voice->started < victim->started))
+			victim = voice;
+	}
+
+// it plays up until the note that takes its place
+	sfxr_SequencerAdvance(sequencer, victim, out, at);
+	sequencer->steals += 1;
+	return victim;
+}
+
+static void sfxr_SequencerPlay(sfxr_Sequencer * sequencer, sfxr_Event const* event, float * out, int at)
+{
+	if(event->channel >= SFXR_SEQUENCER_CHANNELS || event->key > 127)
+	{
+		sequencer->ignored += 1;
+		return;
+	}
+
+	if(event->velocity == 0)
+	{
+		sfxr_SequencerVoice * oldest = nullptr;
+		for(int v = 0; v < SFXR_SEQUENCER_VOICES; ++v)
 		{
-		default:
-			return i;
-		case 1:
+			sfxr_SequencerVoice * voice = &sequencer->voices[v];
+			if(voice->active && voice->data.held && voice->channel == event->channel && voice->key == event->key
+			&& (oldest == nullptr || voice->started < oldest->started))
+				oldest = voice;
+		}
+
+		if(oldest == nullptr) return;
+
+		sfxr_SequencerAdvance(sequencer, oldest, out, at);
+		sfxr_DataNoteOff(&oldest->data);
+		return;
+	}
+
+	if(event->instrument >= SFXR_SEQUENCER_INSTRUMENTS || !sequencer->loaded[event->instrument])
+	{
+		sequencer->ignored += 1;
+		return;
+	}
+
+	sfxr_SequencerVoice * voice = sfxr_SequencerAllocate(sequencer, out, at);
+	sfxr_DataReleasePhaser(&voice->data, &sequencer->phaser_pool);
+	sfxr_DataNoteOn(&voice->data, &sequencer->instruments[event->instrument], event->key);
+	sfxr_DataTakePhaser(&voice->data, &sequencer->phaser_pool);
+
+// same equal power law as the mixer
+	float gain	= sequencer->channel_gain[event->channel] * (event->velocity > 127? 127 : event->velocity) / 127.0f;
+	float angle = (sequencer->channel_pan[event->channel] + 1.0f) * 0.25f * 3.14159265358f;
+
+	voice->left		= gain * cosf(angle);
+	voice->right	= gain * sinf(angle);
+	voice->started	= ++sequencer->clock;
+	voice->channel	= event->channel;
+	sfxr_DataSeed(&voice->data, (unsigned int)voice->started);
+	voice->key		= event->key;
+	voice->active	= 1;
+	voice->rendered = at;
+
+	sequencer->notes += 1;
+}
+
+int sfxr_SequencerRender(sfxr_Sequencer * sequencer, float * out, int frames, sfxr_Event const* events, int count, int * consumed)
+{
+	if(consumed) *consumed = 0;
+	if(sequencer == nullptr || out == nullptr || frames < 0 || count < 0 || (events == nullptr && count > 0)) return -1;
+
+	memset(out, 0, frames * 2 * sizeof(float));
+
+	SFXR_ALIGNED float scratch[SFXR_SEQUENCER_VOICES][SFXR_SEQUENCER_BLOCK];
+	sfxr_Data * data[SFXR_SEQUENCER_VOICES];
+	float * buffers[SFXR_SEQUENCER_VOICES];
+	sfxr_SequencerVoice * playing[SFXR_SEQUENCER_VOICES];
+	int written[SFXR_SEQUENCER_VOICES];
+	int e = 0;
+
+	for(int offset = 0; offset < frames; offset += SFXR_SEQUENCER_BLOCK)
+	{
+		int length = frames - offset < SFXR_SEQUENCER_BLOCK? frames - offset : SFXR_SEQUENCER_BLOCK;
+		unsigned long long start = sequencer->position;
+		float * dst = out + offset*2;
+
+		for(int v = 0; v < SFXR_SEQUENCER_VOICES; ++v)
+			sequencer->voices[v].rendered = 0;
+
+// an event only splits the voice it plays on
+		for(; e < count; ++e)
 		{
-			rep_time= 0;
+			unsigned long long at = sfxr_SequencerSampleOf(sequencer, events[e].tick);
+			if(at >= start + length) break;
 
-			fperiod= 100.0/(model->frequency.base*model->frequency.base+0.001);
-			fslide= 1.0-pow((double)model->frequency.slide, 3.0)*0.01;
+			sfxr_SequencerPlay(sequencer, &events[e], dst, at > start? (int)(at - start) : 0);
+		}
 
-			arp_time= 0;
-			arp_limit= (int)(pow(1.0f-model->arpeggiation.speed, 2.0f)*20000+32);
-			if(model->arpeggiation.speed== 1.0f)
-				arp_limit= 0;
-		}	break;
-		case 2:
+// voices that were split finish the block on their own, everything else is rendered together
+		int n = 0;
+		for(int v = 0; v < SFXR_SEQUENCER_VOICES; ++v)
 		{
-			arp_limit = 0;
-			fperiod *= model->arp_mod;
-		} break;
-		case 3:
+			sfxr_SequencerVoice * voice = &sequencer->voices[v];
+			if(!voice->active) continue;
+
+			if(voice->rendered != 0)
+			{
+				sfxr_SequencerAdvance(sequencer, voice, dst, length);
+				continue;
+			}
+
+			playing[n] = voice;
+			data[n]	   = &voice->data;
+			buffers[n] = scratch[n];
+			++n;
+		}
+
+		if(n != 0)
 		{
-			fperiod = model->fmaxperiod;
-			if(model->frequency.limit > 0.0f)
-				return i;
-		} break;
+			sfxr_DataSynthSampleMulti(data, n, length, buffers, written);
+
+			for(int c = 0; c < n; ++c)
+			{
+				sfxr_SequencerMix(dst, scratch[c], written[c], playing[c]->left, playing[c]->right);
+				if(written[c] < length)
+				{
+					sfxr_DataReleasePhaser(&playing[c]->data, &sequencer->phaser_pool);
+					playing[c]->active = 0;
+				}
+			}
 		}
+
+		sequencer->position = start + length;
 	}
 
-	return i;
+	if(frames == 0)
+	{
+		for(; e < count && sfxr_SequencerSampleOf(sequencer, events[e].tick) <= sequencer->position; ++e)
+			sfxr_SequencerPlay(sequencer, &events[e], out, 0);
+	}
+
+	if(consumed) *consumed = e;
+	return frames;
+}
+
+int sfxr_SequencerReleaseAll(sfxr_Sequencer * sequencer)
+{
+	if(sequencer == nullptr) return -1;
+
+	for(int v = 0; v < SFXR_SEQUENCER_VOICES; ++v)
+	{
+		if(sequencer->voices[v].active)
+			sfxr_DataNoteOff(&sequencer->voices[v].data);
+	}
+
+	return 0;
+}
+
+int sfxr_SequencerActiveVoices(sfxr_Sequencer const* sequencer)
+{
+	if(sequencer == nullptr) return -1;
+
+	int count = 0;
+	for(int v = 0; v < SFXR_SEQUENCER_VOICES; ++v)
+		count += sequencer->voices[v].active != 0;
+
+	return count;
 }
 
 #if INCLUDE_WAV_EXPORT
+int sfxr_ExportSong(sfxr_Sequencer * sequencer, sfxr_Event const* events, int count, int wav_bits, const char * filename)
+{
+	if(sequencer == nullptr || count < 0 || (events == nullptr && count > 0)) return -1;
+
+	sfxr_WavWriter writer;
+	if(sfxr_WavOpen(&writer, filename, wav_bits, 2, sequencer->sample_rate) < 0)
+		return -1;
+
+	float block[2*SFXR_SONG_BLOCK];
+	int frames = 0, used = 0, released = 0;
+
+	while(!released || sfxr_SequencerActiveVoices(sequencer) > 0)
+	{
+		int consumed;
+		if(sfxr_SequencerRender(sequencer, block, SFXR_SONG_BLOCK, events + used, count - used, &consumed) < 0)
+		{
+			sfxr_WavClose(&writer);
+			return -1;
+		}
+		used += consumed;
 
-struct sfxr_WavHeader
+		if(used == count && !released)
+		{
+			sfxr_SequencerReleaseAll(sequencer);
+			released = 1;
+		}
+
+		sfxr_WavWrite(&writer, block, SFXR_SONG_BLOCK);
+		frames += SFXR_SONG_BLOCK;
+	}
+
+	if(sfxr_WavClose(&writer) < 0)
+		return -1;
+
+	return frames;
+}
+#endif
+
+static unsigned int sfxr_GetU16BE(unsigned char const* src)
 {
-	char RIFF[4];
-	unsigned int fileSize;
-	char WAVE[4];
-	char fmt_[4];
+	return (unsigned int)src[0] << 8 | src[1];
+}
 
-	unsigned int chunkSize0;
-	unsigned short compressionCode;
-	unsigned short channels;
-	unsigned int   sampleRate;
-	unsigned int   bytesSec;
-	unsigned short blockAlign;
-	unsigned short bitsPerSample;
+static unsigned int sfxr_GetU32BE(unsigned char const* src)
+{
+	return (unsigned int)src[0] << 24 | (unsigned int)src[1] << 16 | (unsigned int)src[2] << 8 | src[3];
+}
 
-	char data[4];
-	unsigned int chunkSize1;
-};
+// variable length quantity, at most 4 bytes
+static int sfxr_MidiVarLen(unsigned char const** read, unsigned char const* end, unsigned int * value)
+{
+	*value = 0;
 
-// here for reference, only uncompressed is used. (found in ffmpeg)
-enum
+	for(int i = 0; i < 4 && *read < end; ++i)
+	{
+		unsigned char byte = *(*read)++;
+		*value = (*value << 7) | (byte & 0x7F);
+
+		if(!(byte & 0x80))
+			return 0;
+	}
+
+	return -1;
+}
+
+// moves the track on to its next event
+static void sfxr_MidiDelta(sfxr_MidiTrack * track, unsigned char const* read)
 {
-	WAVE_FORMAT_UNKNOWN                    = 0x0000,	// Microsoft Corporation
-	WAVE_FORMAT_UNCOMPRESSED               = 0x0001,	// Microsoft Corporation
-	WAVE_FORMAT_ADPCM                      = 0x0002,	// Microsoft Corporation
-	WAVE_FORMAT_IEEE_FLOAT                 = 0x0003,	// Microsoft Corporation
-	WAVE_FORMAT_VSELP                      = 0x0004,	// Compaq Computer Corp.
-	WAVE_FORMAT_IBM_CVSD                   = 0x0005,	// IBM Corporation
-	WAVE_FORMAT_ALAW                       = 0x0006,	// Microsoft Corporation
-	WAVE_FORMAT_MULAW                      = 0x0007,	// Microsoft Corporation
-	WAVE_FORMAT_DTS                        = 0x0008,	// Microsoft Corporation
-	WAVE_FORMAT_OKI_ADPCM                  = 0x0010,	// OKI
-	WAVE_FORMAT_DVI_ADPCM                  = 0x0011,	// Intel Corporation
-	WAVE_FORMAT_IMA_ADPCM                  = (WAVE_FORMAT_DVI_ADPCM),	//  Intel Corporation
-	WAVE_FORMAT_MEDIASPACE_ADPCM           = 0x0012,	// Videologic
-	WAVE_FORMAT_SIERRA_ADPCM               = 0x0013,	// Sierra Semiconductor Corp
-	WAVE_FORMAT_G723_ADPCM                 = 0x0014,	// Antex Electronics Corporation
-	WAVE_FORMAT_DIGISTD                    = 0x0015,	// DSP Solutions, Inc.
-	WAVE_FORMAT_DIGIFIX                    = 0x0016,	// DSP Solutions, Inc.
-	WAVE_FORMAT_DIALOGIC_OKI_ADPCM         = 0x0017,	// Dialogic Corporation
-	WAVE_FORMAT_MEDIAVISION_ADPCM          = 0x0018,	// Media Vision, Inc.
-	WAVE_FORMAT_CU_CODEC                   = 0x0019,	// Hewlett-Packard Company
-	WAVE_FORMAT_YAMAHA_ADPCM               = 0x0020,	// Yamaha Corporation of America
-	WAVE_FORMAT_SONARC                     = 0x0021,	// Speech Compression
-	WAVE_FORMAT_DSPGROUP_TRUESPEECH        = 0x0022,	// DSP Group, Inc
-	WAVE_FORMAT_ECHOSC1                    = 0x0023,	// Echo Speech Corporation
-	WAVE_FORMAT_AUDIOFILE_AF36             = 0x0024,	// Virtual Music, Inc.
-	WAVE_FORMAT_APTX                       = 0x0025,	// Audio Processing Technology
-	WAVE_FORMAT_AUDIOFILE_AF10             = 0x0026,	// Virtual Music, Inc.
-	WAVE_FORMAT_PROSODY_1612               = 0x0027,	// Aculab plc
-	WAVE_FORMAT_LRC                        = 0x0028,	// Merging Technologies S.A.
-	WAVE_FORMAT_DOLBY_AC2                  = 0x0030,	// Dolby Laboratories
-	WAVE_FORMAT_GSM610                     = 0x0031,	// Microsoft Corporation
-	WAVE_FORMAT_MSNAUDIO                   = 0x0032,	// Microsoft Corporation
-	WAVE_FORMAT_ANTEX_ADPCME               = 0x0033,	// Antex Electronics Corporation
-	WAVE_FORMAT_CONTROL_RES_VQLPC          = 0x0034,	// Control Resources Limited
-	WAVE_FORMAT_DIGIREAL                   = 0x0035,	// DSP Solutions, Inc.
-	WAVE_FORMAT_DIGIADPCM                  = 0x0036,	// DSP Solutions, Inc.
-	WAVE_FORMAT_CONTROL_RES_CR10           = 0x0037,	// Control Resources Limited
-	WAVE_FORMAT_NMS_VBXADPCM               = 0x0038,	// Natural MicroSystems
-	WAVE_FORMAT_CS_IMAADPCM                = 0x0039,	// Crystal Semiconductor IMA ADPCM
-	WAVE_FORMAT_ECHOSC3                    = 0x003A,	// Echo Speech Corporation
-	WAVE_FORMAT_ROCKWELL_ADPCM             = 0x003B,	// Rockwell International
-	WAVE_FORMAT_ROCKWELL_DIGITALK          = 0x003C,	// Rockwell International
-	WAVE_FORMAT_XEBEC                      = 0x003D,	// Xebec Multimedia Solutions Limited
-	WAVE_FORMAT_G721_ADPCM                 = 0x0040,	// Antex Electronics Corporation
-	WAVE_FORMAT_G728_CELP                  = 0x0041,	// Antex Electronics Corporation
-	WAVE_FORMAT_MSG723                     = 0x0042,	// Microsoft Corporation
-	WAVE_FORMAT_MPEG                       = 0x0050,	// Microsoft Corporation
-	WAVE_FORMAT_RT24                       = 0x0052,	// InSoft, Inc.
-	WAVE_FORMAT_PAC                        = 0x0053,	// InSoft, Inc.
-	WAVE_FORMAT_MPEGLAYER3                 = 0x0055,	// ISO/MPEG Layer3 Format Tag
-	WAVE_FORMAT_LUCENT_G723                = 0x0059,	// Lucent Technologies
-	WAVE_FORMAT_CIRRUS                     = 0x0060,	// Cirrus Logic
-	WAVE_FORMAT_ESPCM                      = 0x0061,	// ESS Technology
-	WAVE_FORMAT_VOXWARE                    = 0x0062,	// Voxware Inc
-	WAVE_FORMAT_CANOPUS_ATRAC              = 0x0063,	// Canopus, co., Ltd.
-	WAVE_FORMAT_G726_ADPCM                 = 0x0064,	// APICOM
-	WAVE_FORMAT_G722_ADPCM                 = 0x0065,	// APICOM
-	WAVE_FORMAT_DSAT_DISPLAY               = 0x0067,	// Microsoft Corporation
-	WAVE_FORMAT_VOXWARE_BYTE_ALIGNED       = 0x0069,	// Voxware Inc
-	WAVE_FORMAT_VOXWARE_AC8                = 0x0070,	// Voxware Inc
-	WAVE_FORMAT_VOXWARE_AC10               = 0x0071,	// Voxware Inc
-	WAVE_FORMAT_VOXWARE_AC16               = 0x0072,	// Voxware Inc
-	WAVE_FORMAT_VOXWARE_AC20               = 0x0073,	// Voxware Inc
-	WAVE_FORMAT_VOXWARE_RT24               = 0x0074,	// Voxware Inc
-	WAVE_FORMAT_VOXWARE_RT29               = 0x0075,	// Voxware Inc
-	WAVE_FORMAT_VOXWARE_RT29HW             = 0x0076,	// Voxware Inc
-	WAVE_FORMAT_VOXWARE_VR12               = 0x0077,	// Voxware Inc
-	WAVE_FORMAT_VOXWARE_VR18               = 0x0078,	// Voxware Inc
-	WAVE_FORMAT_VOXWARE_TQ40               = 0x0079,	// Voxware Inc
-	WAVE_FORMAT_SOFTSOUND                  = 0x0080,	// Softsound, Ltd.
-	WAVE_FORMAT_VOXWARE_TQ60               = 0x0081,	// Voxware Inc
-	WAVE_FORMAT_MSRT24                     = 0x0082,	// Microsoft Corporation
-	WAVE_FORMAT_G729A                      = 0x0083,	// AT&T Labs, Inc.
-	WAVE_FORMAT_MVI_MVI2                   = 0x0084,	// Motion Pixels
-	WAVE_FORMAT_DF_G726                    = 0x0085,	// DataFusion Systems (Pty) (Ltd)
-	WAVE_FORMAT_DF_GSM610                  = 0x0086,	// DataFusion Systems (Pty) (Ltd)
-	WAVE_FORMAT_ISIAUDIO                   = 0x0088,	// Iterated Systems, Inc.
-	WAVE_FORMAT_ONLIVE                     = 0x0089,	// OnLive! Technologies, Inc.
-	WAVE_FORMAT_SBC24                      = 0x0091,	// Siemens Business Communications Sys
-	WAVE_FORMAT_DOLBY_AC3_SPDIF            = 0x0092,	// Sonic Foundry
-	WAVE_FORMAT_MEDIASONIC_G723            = 0x0093,	// MediaSonic
-	WAVE_FORMAT_PROSODY_8KBPS              = 0x0094,	// Aculab plc
-	WAVE_FORMAT_ZYXEL_ADPCM                = 0x0097,	// ZyXEL Communications, Inc.
-	WAVE_FORMAT_PHILIPS_LPCBB              = 0x0098,	// Philips Speech Processing
-	WAVE_FORMAT_PACKED                     = 0x0099,	// Studer Professional Audio AG
-	WAVE_FORMAT_MALDEN_PHONYTALK           = 0x00A0,	// Malden Electronics Ltd.
-	WAVE_FORMAT_RHETOREX_ADPCM             = 0x0100,	// Rhetorex Inc.
-	WAVE_FORMAT_IRAT                       = 0x0101,	// BeCubed Software Inc.
-	WAVE_FORMAT_VIVO_G723                  = 0x0111,	// Vivo Software
-	WAVE_FORMAT_VIVO_SIREN                 = 0x0112,	// Vivo Software
-	WAVE_FORMAT_DIGITAL_G723               = 0x0123,	// Digital Equipment Corporation
-	WAVE_FORMAT_SANYO_LD_ADPCM             = 0x0125,	// Sanyo Electric Co., Ltd.
-	WAVE_FORMAT_SIPROLAB_ACEPLNET          = 0x0130,	// Sipro Lab Telecom Inc.
-	WAVE_FORMAT_SIPROLAB_ACELP4800         = 0x0131,	// Sipro Lab Telecom Inc.
-	WAVE_FORMAT_SIPROLAB_ACELP8V3          = 0x0132,	// Sipro Lab Telecom Inc.
-	WAVE_FORMAT_SIPROLAB_G729              = 0x0133,	// Sipro Lab Telecom Inc.
-	WAVE_FORMAT_SIPROLAB_G729A             = 0x0134,	// Sipro Lab Telecom Inc.
-	WAVE_FORMAT_SIPROLAB_KELVIN            = 0x0135,	// Sipro Lab Telecom Inc.
-	WAVE_FORMAT_G726ADPCM                  = 0x0140,	// Dictaphone Corporation
-	WAVE_FORMAT_QUALCOMM_PUREVOICE         = 0x0150,	// Qualcomm, Inc.
-	WAVE_FORMAT_QUALCOMM_HALFRATE          = 0x0151,	// Qualcomm, Inc.
-	WAVE_FORMAT_TUBGSM                     = 0x0155,	// Ring Zero Systems, Inc.
-	WAVE_FORMAT_MSAUDIO1                   = 0x0160,	// Microsoft Corporation
-	WAVE_FORMAT_CREATIVE_ADPCM             = 0x0200,	// Creative Labs, Inc
-	WAVE_FORMAT_CREATIVE_FASTSPEECH8       = 0x0202,	// Creative Labs, Inc
-	WAVE_FORMAT_CREATIVE_FASTSPEECH10      = 0x0203,	// Creative Labs, Inc
-	WAVE_FORMAT_UHER_ADPCM                 = 0x0210,	// UHER informatic GmbH
-	WAVE_FORMAT_QUARTERDECK                = 0x0220,	// Quarterdeck Corporation
-	WAVE_FORMAT_ILINK_VC                   = 0x0230,	// I-link Worldwide
-	WAVE_FORMAT_RAW_SPORT                  = 0x0240,	// Aureal Semiconductor
-	WAVE_FORMAT_IPI_HSX                    = 0x0250,	// Interactive Products, Inc.
-	WAVE_FORMAT_IPI_RPELP                  = 0x0251,	// Interactive Products, Inc.
-	WAVE_FORMAT_CS2                        = 0x0260,	// Consistent Software
-	WAVE_FORMAT_SONY_SCX                   = 0x0270,	// Sony Corp.
-	WAVE_FORMAT_FM_TOWNS_SND               = 0x0300,	// Fujitsu Corp.
-	WAVE_FORMAT_BTV_DIGITAL                = 0x0400,	// Brooktree Corporation
-	WAVE_FORMAT_QDESIGN_MUSIC              = 0x0450,	// QDesign Corporation
-	WAVE_FORMAT_VME_VMPCM                  = 0x0680,	// AT&T Labs, Inc.
-	WAVE_FORMAT_TPC                        = 0x0681,	// AT&T Labs, Inc.
-	WAVE_FORMAT_OLIGSM                     = 0x1000,	// Ing C. Olivetti & C., S.p.A.
-	WAVE_FORMAT_OLIADPCM                   = 0x1001,	// Ing C. Olivetti & C., S.p.A.
-	WAVE_FORMAT_OLICELP                    = 0x1002,	// Ing C. Olivetti & C., S.p.A.
-	WAVE_FORMAT_OLISBC                     = 0x1003,	// Ing C. Olivetti & C., S.p.A.
-	WAVE_FORMAT_OLIOPR                     = 0x1004,	// Ing C. Olivetti & C., S.p.A.
-	WAVE_FORMAT_LH_CODEC                   = 0x1100,	// Lernout & Hauspie
-	WAVE_FORMAT_NORRIS                     = 0x1400,	// Norris Communications, Inc.
-	WAVE_FORMAT_SOUNDSPACE_MUSICOMPRESS    = 0x1500,	// AT&T Labs, Inc.
-	WAVE_FORMAT_DVM                        = 0x2000,	// FAST Multimedia AG
-};
+	unsigned int delta;
+
+	if(read >= track->end || sfxr_MidiVarLen(&read, track->end, &delta) < 0)
+	{
+		track->read = nullptr;
+		return;
+	}
+
+	track->read  = read;
+	track->tick += delta;
+}
+
+static double sfxr_MidiTicksPerSecond(sfxr_MidiPlayer const* player, unsigned int tempo)
+{
+// smpte division is frames per second and ticks per frame, tempo doesn't come into it
+	if(player->division & 0x8000)
+	{
+		int fps = -(signed char)(player->division >> 8);
+		return (fps == 29? 29.97 : fps) * (player->division & 0xFF);
+	}
 
-int sfxr_ExportWAV_F(sfxr_Settings const* settings, int wav_bits, int sample_rate,  const char* filename_format, ...)
+	return player->division * 1000000.0 / tempo;
+}
+
+int sfxr_MidiOpen(sfxr_MidiPlayer * player, sfxr_Sequencer * sequencer, void const* data, size_t size)
 {
-	if(wav_bits < 0)	wav_bits = 32;
-	if(sample_rate < 0)  sample_rate = 44100;
+	if(player == nullptr || sequencer == nullptr || data == nullptr) return -1;
+
+	unsigned char const* read = data;
+	unsigned char const* end  = read + size;
 
-	if(wav_bits != 8 && wav_bits != 16 && wav_bits != 32)
+	if(size < 14 || memcmp(read, "MThd", 4) != 0 || sfxr_GetU32BE(read + 4) < 6)
 		return -1;
-	if(sample_rate > 44100)
+
+	unsigned int format = sfxr_GetU16BE(read + 8);
+	unsigned int tracks = sfxr_GetU16BE(read + 10);
+
+	if(format > 1 || tracks > SFXR_MIDI_TRACKS)
 		return -1;
 
-	if(settings == NULL) return -1;
+	memset(player, 0, sizeof(*player));
+	player->sequencer = sequencer;
+	player->division  = sfxr_GetU16BE(read + 12);
 
-	va_list vlist;
-	va_start(vlist, filename_format);
-	char filename[FILENAME_MAX];
-	int result = vsnprintf(filename, sizeof(filename), filename_format, vlist);
+	if(player->division == 0)
+		return -1;
 
-	if(result < 0)
-		return result;
-	va_end(vlist);
+	for(int c = 0; c < SFXR_SEQUENCER_CHANNELS; ++c)
+		player->instruments[c] = c;
 
-	return sfxr_ExportWAV_F(settings, wav_bits, sample_rate, filename);
-}
+	read += 8 + sfxr_GetU32BE(read + 4);
 
-int sfxr_ExportWAV(sfxr_Settings const* s, int wav_bits, int sample_rate, const char* filename)
-{
-	if(wav_bits < 0)	wav_bits = 32;
-	if(sample_rate < 0)  sample_rate = 44100;
+// chunks that aren't tracks are skipped
+	while(player->track_count < (int)tracks && end - read >= 8)
+	{
+		unsigned int length = sfxr_GetU32BE(read + 4);
+		if(length > (size_t)(end - read) - 8)
+			length = (unsigned int)(end - read) - 8;
 
-	if(wav_bits != 8 && wav_bits != 16 && wav_bits != 32)
-		return -1;
-	if(sample_rate > 44100)
-		return -1;
+		if(memcmp(read, "MTrk", 4) == 0)
+		{
+			sfxr_MidiTrack * track = &player->tracks[player->track_count++];
+			track->end = read + 8 + length;
+			sfxr_MidiDelta(track, read + 8);
+		}
 
-	if(s == NULL) return -1;
+		read += 8 + length;
+	}
 
-	FILE* foutput= fopen(filename, "wb");
-	if(!foutput)
-		return -1;
+// midi tick 0 is now, at 120 beats per minute until the file says otherwise
+	sequencer->tempo_tick		= 0;
+	sequencer->tempo_sample		= sequencer->position;
+	sequencer->samples_per_tick = sequencer->sample_rate / sfxr_MidiTicksPerSecond(player, 500000);
+
+	return 0;
+}
 
-	// write wav header
+int sfxr_MidiSetInstrument(sfxr_MidiPlayer * player, int channel, int instrument)
+{
+	if(player == nullptr || channel < 0 || channel >= SFXR_SEQUENCER_CHANNELS || instrument < 0 || instrument >= SFXR_SEQUENCER_INSTRUMENTS) return -1;
 
-	struct sfxr_WavHeader header = {
-		.RIFF = {'R', 'I', 'F', 'F'},
-		.fileSize = 0,
-		.WAVE = {'W', 'A', 'V', 'E'},
-		.fmt_ = {'f', 'm', 't', ' '},
+	player->instruments[channel] = instrument;
+	return 0;
+}
 
-		.chunkSize0 = 16,
-		.compressionCode = WAVE_FORMAT_UNCOMPRESSED,
-		.channels = 1,
-		.sampleRate = sample_rate,
-		.bytesSec = sample_rate*wav_bits/8,
-		.blockAlign = wav_bits/8,
-		.bitsPerSample = wav_bits,
+static void sfxr_MidiDecode(sfxr_MidiPlayer * player, sfxr_MidiTrack * track)
+{
+	unsigned char const* read = track->read;
+	unsigned char const* end  = track->end;
+	unsigned char status = *read & 0x80? *read++ : track->status;
 
-		.data = {'d', 'a', 't', 'a'},
-		.chunkSize1 = 0
-	};
+	if(status >= 0x80 && status < 0xF0)
+	{
+		int length = (status & 0xE0) == 0xC0? 1 : 2;
+		if(end - read < length)
+		{
+			track->read = nullptr;
+			return;
+		}
 
-	fwrite(&header, sizeof(header), 1, foutput);
+		int type = status & 0xF0;
+		if(type == 0x80 || type == 0x90)
+		{
+			sfxr_Event * event = &player->events[player->event_count++];
+			event->tick		  = (unsigned int)track->tick;
+			event->channel	  = status & 0x0F;
+			event->instrument = player->instruments[status & 0x0F];
+			event->key		  = read[0] & 0x7F;
+			event->velocity	  = type == 0x90? read[1] & 0x7F : 0;
+		}
 
-	// write sample data
-	sfxr_Model model;
-	sfxr_Data  data;
+		track->status = status;
+		sfxr_MidiDelta(track, read + length);
+		return;
+	}
 
-	sfxr_ModelInit(&model, s);
-	sfxr_DataInit(&data, &model);
+// meta and sysex events cancel running status, anything else shouldn't be in a file
+	unsigned char meta = 0;
+	unsigned int length;
 
-	int no_samples = sfxr_ComputeRemainingSamples(&data);
-// padd a bit cause some audio players will cut off it samples is too short
-	no_samples = (no_samples + 255) & 0xFFFFFFF0;
-	float * buffer = malloc(no_samples * sizeof(float));
+	track->status = 0;
+	if(status == 0xFF && read < end)
+		meta = *read++;
+	else if(status != 0xF0 && status != 0xF7)
+		read = end;
 
-	int samples = sfxr_DataSynthSample(&data, no_samples, buffer);
-// clear out tail.
-	memset(&buffer[samples], 0, (no_samples-samples)*sizeof(float));
-	samples = no_samples;
+	if(read >= end || sfxr_MidiVarLen(&read, end, &length) < 0 || length > (size_t)(end - read) || meta == 0x2F)
+	{
+		track->read = nullptr;
+		return;
+	}
 
-// gain
-//	for(int i = 0; i < samples; ++i)
-//	{
-//		buffer[i] *= 4.0f;
-//		if(buffer[i] > 1.0f) buffer[i]= 1.0f;
-//		if(buffer[i] < -1.0f) buffer[i]= -1.0f;
-//	}
+	if(meta == 0x51 && length == 3)
+	{
+		player->tempo_pending = 1;
+		player->tempo_tick	  = track->tick;
+		player->tempo		  = sfxr_MidiTicksPerSecond(player, read[0] << 16 | read[1] << 8 | read[2]);
+	}
 
+	sfxr_MidiDelta(track, read + length);
+}
 
-// supersample
-	samples = sfxr_Downsample(buffer, samples, buffer, samples, sample_rate, 44100);
+// the track with the earliest event, earlier tracks first on a tie so the tempo track leads
+static sfxr_MidiTrack * sfxr_MidiNext(sfxr_MidiPlayer * player)
+{
+	sfxr_MidiTrack * next = nullptr;
 
-// export
-	if(wav_bits == 32)
+	for(int t = 0; t < player->track_count; ++t)
 	{
-		fwrite(buffer, samples, 4, foutput);
+		sfxr_MidiTrack * track = &player->tracks[t];
+		if(track->read != nullptr && (next == nullptr || track->tick < next->tick))
+			next = track;
 	}
-	else if(wav_bits == 16)
+
+	return next;
+}
+
+// tops up the window of events until it's full, a tempo change is reached or the song runs out
+static void sfxr_MidiFill(sfxr_MidiPlayer * player)
+{
+	player->event_count -= player->event_read;
+	memmove(player->events, player->events + player->event_read, player->event_count * sizeof(sfxr_Event));
+	player->event_read = 0;
+
+	while(player->event_count < SFXR_MIDI_EVENTS && !player->tempo_pending)
 	{
-		sfxr_Quantize16((uint16_t*)buffer, buffer, samples);
-		fwrite(buffer, samples, 2, foutput);
+		sfxr_MidiTrack * track = sfxr_MidiNext(player);
+		if(track == nullptr) break;
+
+		sfxr_MidiDecode(player, track);
 	}
-	else if(wav_bits == 8)
+}
+
+int sfxr_MidiRender(sfxr_MidiPlayer * player, float * out, int frames)
+{
+	if(player == nullptr || player->sequencer == nullptr || out == nullptr || frames < 0) return -1;
+
+	sfxr_Sequencer * sequencer = player->sequencer;
+	int done = 0;
+
+	while(done < frames)
 	{
-		sfxr_Quantize8((uint8_t*)buffer, buffer, samples);
-		fwrite(buffer, samples, 1, foutput);
+		sfxr_MidiFill(player);
+
+// everything before the next undecoded event is in the window, that's as far as it can go
+		sfxr_MidiTrack * next = sfxr_MidiNext(player);
+		int length = frames - done;
+
+		if(next != nullptr || player->tempo_pending)
+		{
+			unsigned long long horizon = next == nullptr? player->tempo_tick : next->tick;
+			if(player->tempo_pending && player->tempo_tick < horizon)
+				horizon = player->tempo_tick;
+
+			unsigned long long at = sfxr_SequencerSampleOf(sequencer, (unsigned int)horizon);
+			if(at < sequencer->position + length)
+				length = at > sequencer->position? (int)(at - sequencer->position) : 0;
+		}
+		else if(player->event_read == player->event_count)
+		{
+// the song is over, let notes that never got a note off go
+			if(!player->released)
+			{
+				sfxr_SequencerReleaseAll(sequencer);
+				player->released = 1;
+			}
+
+			if(sfxr_SequencerActiveVoices(sequencer) == 0)
+				break;
+		}
+
+		int consumed;
+		if(sfxr_SequencerRender(sequencer, out + done*2, length, player->events + player->event_read,
+			player->event_count - player->event_read, &consumed) < 0)
+			return -1;
+
+		player->event_read += consumed;
+		done += length;
+
+		if(length == 0 && player->tempo_pending
+		&& sfxr_SequencerSampleOf(sequencer, (unsigned int)player->tempo_tick) <= sequencer->position)
+		{
+			sfxr_SequencerSetTempo(sequencer, player->tempo);
+			player->tempo_pending = 0;
+		}
 	}
 
-	free(buffer);
+	return done;
+}
+
+#if INCLUDE_WAV_EXPORT
+int sfxr_ExportMidi(sfxr_Sequencer * sequencer, void const* data, size_t size, int wav_bits, const char * filename)
+{
+	sfxr_MidiPlayer player;
+	if(sfxr_MidiOpen(&player, sequencer, data, size) < 0)
+		return -1;
 
-	unsigned int foutstream_datasize = sizeof(header)-4;
+	sfxr_WavWriter writer;
+	if(sfxr_WavOpen(&writer, filename, wav_bits, 2, sequencer->sample_rate) < 0)
+		return -1;
 
-	// seek back to header and write size info
-	fseek(foutput, 4, SEEK_SET);
-	unsigned int dword= 0;
-	dword= foutstream_datasize-4+samples*wav_bits/8;
-	fwrite(&dword, 1, 4, foutput); // remaining file size
-	fseek(foutput, foutstream_datasize, SEEK_SET);
-	dword= samples*wav_bits/8;
-	fwrite(&dword, 1, 4, foutput); // chunk size (data)
-	fclose(foutput);
+	float block[2*SFXR_SONG_BLOCK];
+	int frames = 0;
 
-	return 0;
+	for(int length = SFXR_SONG_BLOCK; length == SFXR_SONG_BLOCK; frames += length)
+	{
+		length = sfxr_MidiRender(&player, block, SFXR_SONG_BLOCK);
+		if(length < 0)
+		{
+			sfxr_WavClose(&writer);
+			return -1;
+		}
+
+		sfxr_WavWrite(&writer, block, length);
+	}
+
+	if(sfxr_WavClose(&writer) < 0)
+		return -1;
+
+	return frames;
 }
+#endif
 
 #endif
 
@@ -666,26 +4102,14 @@ int sfxr_Downsample(float * dst, int dst_length, float* src, int src_length, int
 		return cpy;
 	}
 
-	float ratio =  src_sample_rate / (float)dst_sample_rate;
-	float counter = -ratio;
-	float accumulator = 0.f;
-	int   denominator = 0;
+	if(dst == src && dst_sample_rate > src_sample_rate) return -1;
 
-	int write = 0;
-	for(int read = 0; read < src_length && write < dst_length; ++read)
-	{
-		accumulator += src[read];
-		denominator += 1;
-
-		if((counter += 1) > ratio)
-		{
-			dst[write++] = accumulator / denominator;
+	sfxr_Resampler resampler;
+	if(sfxr_ResamplerInit(&resampler, dst_sample_rate, src_sample_rate, 1) < 0)
+		return -1;
 
-			counter    -= ratio;
-			denominator = 0;
-			accumulator = 0;
-		}
-	}
+	int write = sfxr_ResamplerRun(&resampler, dst, dst_length, src, src_length, nullptr);
+	write += sfxr_ResamplerFlush(&resampler, dst + write, dst_length - write);
 
 // clear out tail
 	int padded = (write + 255) & 0xFFFFFFF0;
@@ -694,26 +4118,153 @@ int sfxr_Downsample(float * dst, int dst_length, float* src, int src_length, int
 	return padded;
 }
 
-int sfxr_Quantize8(unsigned char * dst, float* src, int length)
+int sfxr_DitherInit(sfxr_Dither * dither, unsigned int seed)
 {
-	if(dst == 0 || src == 0) return -1;
+	if(dither == nullptr) return -1;
 
-	for(int i = 0; i < length; ++i)
-		dst[i] = src[i] *127 + 128;
+	for(unsigned int l = 0; l < SFXR_DITHER_LANES; ++l)
+	{
+		unsigned int x = seed + l * 0x9E3779B9u;
+		x ^= x >> 16;
+		x *= 0x7FEB352Du;
+		x ^= x >> 15;
+		x *= 0x846CA68Bu;
+		x ^= x >> 16;
+// xorshift gets stuck on 0
+		dither->state[l] = x? x : 2463534242u;
+	}
 
-	return length;
+	return 0;
 }
 
-int sfxr_Quantize16(unsigned short * dst, float* src, int length)
+static inline vi sfxr_DitherStep(vi x)
 {
-	if(dst == 0 || src == 0) return -1;
+	x = vi_xor(x, vi_sll(x, 13));
+	x = vi_xor(x, vi_srl(x, 17));
+	return vi_xor(x, vi_sll(x, 5));
+}
 
-	for(int i = 0; i < length; ++i)
-		dst[i] = src[i] * 32000;
+// scale/offset to the integer range, add dither, clamp and round. NaN comes out as lo.
+static inline vi sfxr_QuantizeVector(vf v, vf scale, vf offset, vf lo, vf hi, vi * state)
+{
+	v = vf_add(vf_mul(v, scale), offset);
+
+	if(state)
+	{
+		vi a = *state = sfxr_DitherStep(*state);
+		vi b = *state = sfxr_DitherStep(*state);
+		vf tpdf = vf_sub(vi_to_vf(vi_srl(a, 8)), vi_to_vf(vi_srl(b, 8)));
+		v = vf_add(v, vf_mul(tpdf, vf_set1(1.f / 16777216.f)));
+	}
+
+	return vf_to_vi(vf_min(vf_max(v, lo), hi));
+}
+
+static inline void sfxr_QuantizeStore(void * dst, int i, vi q, int format, int count)
+{
+	SFXR_ALIGNED int32_t lanes[SFXR_SIMD_WIDTH];
+
+	if(count == SFXR_SIMD_WIDTH && format == sfxr_S16)
+		vi_store16((int16_t*)dst + i, q);
+	else if(count == SFXR_SIMD_WIDTH && format == sfxr_U8)
+		vi_store8((uint8_t*)dst + i, q);
+	else
+	{
+		vi_store(lanes, q);
+		for(int l = 0; l < count; ++l)
+		{
+			switch(format)
+			{
+			case sfxr_U8:
+				((uint8_t*)dst)[i+l] = lanes[l];
+				break;
+			case sfxr_S16:
+				((int16_t*)dst)[i+l] = lanes[l];
+				break;
+			default:
+			{
+				uint8_t * p = (uint8_t*)dst + (i+l)*3;
+				p[0] = lanes[l];
+				p[1] = lanes[l] >> 8;
+				p[2] = lanes[l] >> 16;
+			}	break;
+			}
+		}
+	}
+}
+
+int sfxr_Quantize(void * dst, float const* src, int length, enum sfxr_SampleFormat format, sfxr_Dither * dither)
+{
+	if(dst == 0 || src == 0 || length < 0) return -1;
+
+	if(format == sfxr_F32)
+	{
+		vf lo = vf_set1(-1.0f), hi = vf_set1(1.0f);
+		int i = 0;
+		for(; i + SFXR_SIMD_WIDTH <= length; i += SFXR_SIMD_WIDTH)
+			vf_storeu((float*)dst + i, vf_min(vf_max(vf_loadu(src + i), lo), hi));
+		for(; i < length; ++i)
+		{
+			float v = src[i];
+			((float*)dst)[i] = v > 1.0f? 1.0f : v > -1.0f? v : -1.0f;
+		}
+		return length;
+	}
+
+	float range;
+	switch(format)
+	{
+	case sfxr_U8:  range = 127.f; break;
+	case sfxr_S16: range = 32767.f; break;
+	case sfxr_S24: range = 8388607.f; break;
+	default: return -1;
+	}
+
+	vf scale  = vf_set1(range);
+	vf offset = vf_set1(format == sfxr_U8? 128.f : 0.f);
+	vf lo	  = vf_set1(format == sfxr_U8? 0.f : -range-1);
+	vf hi	  = vf_set1(format == sfxr_U8? 255.f : range);
+
+	SFXR_ALIGNED int32_t seed[SFXR_SIMD_WIDTH];
+	vi state, * pstate = nullptr;
+	if(dither)
+	{
+		memcpy(seed, dither->state, sizeof(seed));
+		state  = vi_load(seed);
+		pstate = &state;
+	}
+
+// every vector is loaded before anything is stored, and the output is never wider than the input, so dst may be src
+	int i = 0;
+	for(; i + SFXR_SIMD_WIDTH <= length; i += SFXR_SIMD_WIDTH)
+		sfxr_QuantizeStore(dst, i, sfxr_QuantizeVector(vf_loadu(src + i), scale, offset, lo, hi, pstate), format, SFXR_SIMD_WIDTH);
+
+	if(i < length)
+	{
+		SFXR_ALIGNED float tail[SFXR_SIMD_WIDTH] = {0};
+		memcpy(tail, src + i, (length - i) * sizeof(float));
+		sfxr_QuantizeStore(dst, i, sfxr_QuantizeVector(vf_load(tail), scale, offset, lo, hi, pstate), format, length - i);
+	}
+
+	if(dither)
+	{
+		vi_store(seed, state);
+		memcpy(dither->state, seed, sizeof(seed));
+	}
 
 	return length;
 }
 
+int sfxr_Quantize8(unsigned char * dst, float const* src, int length)
+{
+	return sfxr_Quantize(dst, src, length, sfxr_U8, nullptr);
+}
+
+int sfxr_Quantize16(short * dst, float const* src, int length)
+{
+	return sfxr_Quantize(dst, src, length, sfxr_S16, nullptr);
+}
+
 int sfxr_InitInternal(sfxr_Settings * dst)
 {
 	if(!dst) return -1;
@@ -1103,6 +4654,36 @@ void sfxr_UnitTestTranslationFunctions()
 	}
 }
 
+// checks sfxr_FastSin against libm over a turn in steps of 2^-20 and over a long vibrato's worth of phase
+// writes one json object to file (if not null), returns how many points were off by more than SFXR_FAST_SIN_ERROR.
+int sfxr_UnitTestFastSin(FILE * file)
+{
+	double max_error = 0;
+	int failures = 0;
+
+	for(int i = 0; i <= 1 << 20; ++i)
+	{
+		float turns = (float)i / (1 << 20);
+		double error = fabs(sfxr_FastSin(turns) - sin(turns*2*3.14159265358));
+		failures += error > SFXR_FAST_SIN_ERROR;
+		if(error > max_error) max_error = error;
+	}
+
+	for(int i = 0; i <= 1 << 20; ++i)
+	{
+		float phase = i * 0.01f;
+		double turns = phase*0.15915494309189535;
+		double error = fabs(sfxr_FastSin((float)(turns-(long long)turns)) - sin(phase));
+		failures += error > SFXR_FAST_SIN_ERROR;
+		if(error > max_error) max_error = error;
+	}
+
+	if(file != nullptr)
+		fprintf(file, "{\"fast_sin_max_error\": %g, \"bound\": %g, \"failures\": %d}\n", max_error, SFXR_FAST_SIN_ERROR, failures);
+
+	return failures;
+}
+
 #endif
 
 static char GetKey(char c)
@@ -1285,6 +4866,147 @@ int sfxr_SettingsToJson(FILE * file, sfxr_Settings * data)
 	return 0;
 }
 
+enum
+{
+	SFXR_PACK_VERSION = 1,
+	SFXR_PACK_HEADER = 12,
+// every field but the wave type is a float
+	SFXR_PACK_FIELDS = (sizeof(sfxr_Settings) - sizeof(enum sfxr_WaveType)) / sizeof(float),
+	SFXR_PACK_MASK = (SFXR_PACK_FIELDS + 7) / 8
+};
+
+// the records walk sfxr_Settings as the wave type followed by a flat array of floats, new fields go on the end
+_Static_assert(offsetof(sfxr_Settings, envelope) == sizeof(enum sfxr_WaveType) && sizeof(enum sfxr_WaveType) == sizeof(float)
+	&& sizeof(sfxr_Settings) == offsetof(sfxr_Settings, highPassFilter.cuttofSweep_sec) + sizeof(float)
+	&& SFXR_PACK_FIELDS == 23, "sfxr_Settings isn't laid out the way the packed records assume");
+
+static float const* sfxr_SettingsFields(sfxr_Settings const* s) { return (float const*)(&s->wave_type + 1); }
+
+size_t sfxr_SettingsPack(void * dst, size_t capacity, sfxr_Settings const* settings, int count)
+{
+	if(settings == nullptr || count < 0) return 0;
+
+	size_t size = SFXR_PACK_HEADER;
+	for(int i = 0; i < count; ++i)
+	{
+		float const* fields = sfxr_SettingsFields(&settings[i]);
+		size += 1 + SFXR_PACK_MASK;
+		for(int f = 0; f < SFXR_PACK_FIELDS; ++f)
+			size += fields[f] != 0.0f? 4 : 0;
+	}
+
+	if(dst == nullptr || capacity < size)
+		return size;
+
+	unsigned char * out = dst;
+	memcpy(out, "SFXS", 4);
+	out[4] = SFXR_PACK_VERSION;
+	out[5] = SFXR_PACK_FIELDS;
+	out[6] = 0;
+	out[7] = 0;
+	sfxr_PutU32(out+8, count);
+	out += SFXR_PACK_HEADER;
+
+	for(int i = 0; i < count; ++i)
+	{
+		float const* fields = sfxr_SettingsFields(&settings[i]);
+		unsigned char * mask = out+1;
+
+		out[0] = settings[i].wave_type;
+		memset(mask, 0, SFXR_PACK_MASK);
+		out += 1 + SFXR_PACK_MASK;
+
+		for(int f = 0; f < SFXR_PACK_FIELDS; ++f)
+		{
+// compare as a float so -0 gets dropped too, it reads back as 0
+			if(fields[f] == 0.0f) continue;
+
+			uint32_t bits;
+			memcpy(&bits, &fields[f], 4);
+			sfxr_PutU32(out, bits);
+			mask[f >> 3] |= 1 << (f & 7);
+			out += 4;
+		}
+	}
+
+	return size;
+}
+
+int sfxr_SettingsToBinary(FILE * file, sfxr_Settings const* settings, int count)
+{
+	if(file == nullptr || settings == nullptr || count < 0) return -1;
+
+// one record at a time through a small buffer; the header is patched with the count at the start
+	unsigned char buffer[SFXR_PACK_HEADER + 1 + SFXR_PACK_MASK + SFXR_PACK_FIELDS*4];
+
+	sfxr_SettingsPack(buffer, sizeof(buffer), settings, 0);
+	sfxr_PutU32(buffer+8, count);
+	fwrite(buffer, SFXR_PACK_HEADER, 1, file);
+
+	for(int i = 0; i < count; ++i)
+	{
+		size_t size = sfxr_SettingsPack(buffer, sizeof(buffer), &settings[i], 1);
+		fwrite(buffer + SFXR_PACK_HEADER, size - SFXR_PACK_HEADER, 1, file);
+	}
+
+	return ferror(file)? -1 : 0;
+}
+
+int sfxr_SettingsUnpack(sfxr_Settings * dst, int max, void const* src, size_t size)
+{
+	if(src == nullptr || size < SFXR_PACK_HEADER) return -1;
+
+	unsigned char const* in = src;
+	unsigned char const* end = in + size;
+
+	if(memcmp(in, "SFXS", 4) != 0 || in[4] != SFXR_PACK_VERSION)
+		return -1;
+
+// newer writers may store more fields, extra ones are skipped
+	int fields_stored = in[5];
+	int mask_size	  = (fields_stored + 7) / 8;
+	uint32_t count	  = sfxr_GetU32(in+8);
+	in += SFXR_PACK_HEADER;
+
+	if(count > 0x7FFFFFFF) return -1;
+
+	for(uint32_t i = 0; i < count; ++i)
+	{
+		if(end - in < 1 + mask_size)
+			return -1;
+
+		unsigned char const* mask = in+1;
+		sfxr_Settings * s = dst != nullptr && (int)i < max? &dst[i] : nullptr;
+
+		if(in[0] > sfxr_Table)
+			return -1;
+
+		if(s != nullptr)
+		{
+			memset(s, 0, sizeof(*s));
+			s->wave_type = in[0];
+		}
+
+		in += 1 + mask_size;
+
+		float * fields = s != nullptr? (float*)(&s->wave_type + 1) : nullptr;
+		for(int f = 0; f < fields_stored; ++f)
+		{
+			if(!(mask[f >> 3] >> (f & 7) & 1)) continue;
+			if(end - in < 4) return -1;
+
+			if(fields != nullptr && f < SFXR_PACK_FIELDS)
+			{
+				uint32_t bits = sfxr_GetU32(in);
+				memcpy(&fields[f], &bits, 4);
+			}
+			in += 4;
+		}
+	}
+
+	return count;
+}
+
 
 const double SAMPLES = SAMPLE_RATE;
 const double SAMPLES1 = 44101;
@@ -1303,6 +5025,11 @@ static double InternalFromHz(double v) { return sqrt(100.0 / (8 * SAMPLE_RATE) *
 
 
 int sfxr_ReadableToInternal(struct sfxr_Settings * dst, struct sfxr_Settings const* src)
+{
+	return sfxr_ReadableToInternalGroups(dst, src, sfxr_GroupAll);
+}
+
+int sfxr_ReadableToInternalGroups(struct sfxr_Settings * dst, struct sfxr_Settings const* src, unsigned int groups)
 {
 	if(dst == nullptr || src == nullptr) return -1;
 	if(dst != src)
@@ -1314,69 +5041,96 @@ int sfxr_ReadableToInternal(struct sfxr_Settings * dst, struct sfxr_Settings con
 
 	double v;
 
-	dst->envelope.attackSec		= InternalFromSec(dst->envelope.attackSec);
-	dst->envelope.sustainSec	= InternalFromSec(dst->envelope.sustainSec);
-	dst->envelope.decaySec		= InternalFromSec(dst->envelope.decaySec);
-	dst->envelope.punchPercent	= dst->envelope.punchPercent / 100;
+	if(groups & sfxr_GroupEnvelope)
+	{
+		dst->envelope.attackSec		= InternalFromSec(dst->envelope.attackSec);
+		dst->envelope.sustainSec	= InternalFromSec(dst->envelope.sustainSec);
+		dst->envelope.decaySec		= InternalFromSec(dst->envelope.decaySec);
+		dst->envelope.punchPercent	= dst->envelope.punchPercent / 100;
+	}
 
-	dst->frequency.baseHz = InternalFromHz(dst->frequency.baseHz );
-	dst->frequency.limitHz = InternalFromHz(dst->frequency.limitHz );
+	if(groups & sfxr_GroupFrequency)
+	{
+		dst->frequency.baseHz = InternalFromHz(dst->frequency.baseHz );
+		dst->frequency.limitHz = InternalFromHz(dst->frequency.limitHz );
 
-	v = exp(dst->frequency.slideOctaves_s * log_half / SAMPLES);
-	dst->frequency.slideOctaves_s = cbrt((1.0 -v) * 100);
+		v = exp(dst->frequency.slideOctaves_s * log_half / SAMPLES);
+		dst->frequency.slideOctaves_s = cbrt((1.0 -v) * 100);
 
-	v = dst->frequency.slideOctaves_s2 * exp2(-SAMPLES1/SAMPLES) / SAMPLES;
-	dst->frequency.slideOctaves_s2 = cbrt(-v /  0.000001);
+		v = dst->frequency.slideOctaves_s2 * exp2(-SAMPLES1/SAMPLES) / SAMPLES;
+		dst->frequency.slideOctaves_s2 = cbrt(-v /  0.000001);
 
-	v = dst->vibrato.speedHz / (SAMPLES * 10/64.0);
-	dst->vibrato.speedHz = sqrt(v * 100.0);
+		if(isnormal(dst->frequency.slideOctaves_s) == 0)
+			dst->frequency.slideOctaves_s = 0;
 
-	dst->vibrato.strengthPercent = dst->vibrato.strengthPercent / (0.5 * 100);
+		if(isnormal(dst->frequency.slideOctaves_s2) == 0)
+			dst->frequency.slideOctaves_s2 = 0;
+	}
 
-	dst->vibrato.delaySec = InternalFromSec(dst->vibrato.delaySec);
+	if(groups & sfxr_GroupVibrato)
+	{
+		v = dst->vibrato.speedHz / (SAMPLES * 10/64.0);
+		dst->vibrato.speedHz = sqrt(v * 100.0);
 
-	v = exp2(dst->arpeggiation.frequencySemitones / 12.0);
-	v = 1.f / max(v, 1e-5);
-	dst->arpeggiation.frequencySemitones = v < 1? sqrt(fabs(1.0 - v) / 0.9) : -sqrt((v - 1.0) / 10.0) ;
+		dst->vibrato.strengthPercent = dst->vibrato.strengthPercent / (0.5 * 100);
 
-	v = (dst->arpeggiation.speedSec * SAMPLES);
-	dst->arpeggiation.speedSec =  (v == 0) ? 1.0 :	(1.0 - sqrt((v - (v < 100 ? 30 : 32)) / 20000));
+		dst->vibrato.delaySec = InternalFromSec(dst->vibrato.delaySec);
+	}
 
-	v = dst->duty.cyclePercent * 0.01;
-	dst->duty.cyclePercent = (v - 0.5) * -2.0;
+	if(groups & sfxr_GroupArpeggiation)
+	{
+		v = exp2(dst->arpeggiation.frequencySemitones / 12.0);
+		v = 1.f / max(v, 1e-5);
+		dst->arpeggiation.frequencySemitones = v < 1? sqrt(fabs(1.0 - v) / 0.9) : -sqrt((v - 1.0) / 10.0) ;
 
-	v = (dst->duty.sweepPercent_sec) / (8 * SAMPLES );
-	dst->duty.sweepPercent_sec = -v /  0.00005;
+		v = (dst->arpeggiation.speedSec * SAMPLES);
+		dst->arpeggiation.speedSec =  (v == 0) ? 1.0 :	(1.0 - sqrt((v - (v < 100 ? 30 : 32)) / 20000));
+	}
 
-	v =  dst->retrigger.rateHz == 0? 0.0f : dst->retrigger.rateHz / SAMPLES;
-	dst->retrigger.rateHz =  v == 0? 0.0f : 1.0 - sqrt(fabs(v - 32) / 20000);
+	if(groups & sfxr_GroupDuty)
+	{
+		v = dst->duty.cyclePercent * 0.01;
+		dst->duty.cyclePercent = (v - 0.5) * -2.0;
 
-	v =  dst->flanger.offsetMs_sec * SAMPLES / 1000;
-	dst->flanger.offsetMs_sec = SIGN(v) * sqrt(fabs(v) / 1020);
+		v = (dst->duty.sweepPercent_sec) / (8 * SAMPLES );
+		dst->duty.sweepPercent_sec = -v /  0.00005;
+	}
 
-	v = dst->flanger.sweepMs_sec2 / 100;
-	dst->flanger.sweepMs_sec2 = SIGN(v) * sqrt(fabs(v));
+	if(groups & sfxr_GroupRetrigger)
+	{
+		v =  dst->retrigger.rateHz == 0? 0.0f : dst->retrigger.rateHz / SAMPLES;
+		dst->retrigger.rateHz =  v == 0? 0.0f : 1.0 - sqrt(fabs(v - 32) / 20000);
+	}
 
-	v = dst->lowPassFilter.cutoffFrequencyHz / (dst->lowPassFilter.cutoffFrequencyHz + (8 * SAMPLES));
-	dst->lowPassFilter.cutoffFrequencyHz = cbrt(v * 10);
+	if(groups & sfxr_GroupFlanger)
+	{
+		v =  dst->flanger.offsetMs_sec * SAMPLES / 1000;
+		dst->flanger.offsetMs_sec = SIGN(v) * sqrt(fabs(v) / 1020);
 
-	v =  pow(dst->lowPassFilter.cuttofSweep_sec, 1.0 / SAMPLES);
-	dst->lowPassFilter.cuttofSweep_sec =  (v - 1.0) / 0.0001;
+		v = dst->flanger.sweepMs_sec2 / 100;
+		dst->flanger.sweepMs_sec2 = SIGN(v) * sqrt(fabs(v));
+	}
 
-	v =  (100 - dst->lowPassFilter.resonancePercent) / 11.0;
-	dst->lowPassFilter.resonancePercent =  sqrt((1.0 / (v / 5.0) - 1) / 20);
+	if(groups & sfxr_GroupLowPass)
+	{
+		v = dst->lowPassFilter.cutoffFrequencyHz / (dst->lowPassFilter.cutoffFrequencyHz + (8 * SAMPLES));
+		dst->lowPassFilter.cutoffFrequencyHz = cbrt(v * 10);
 
-	v = dst->highPassFilter.cutoffFrequencyHz / (dst->highPassFilter.cutoffFrequencyHz + (8 * SAMPLES));
-	dst->highPassFilter.cutoffFrequencyHz = sqrt(v * 10.0);
+		v =  pow(dst->lowPassFilter.cuttofSweep_sec, 1.0 / SAMPLES);
+		dst->lowPassFilter.cuttofSweep_sec =  (v - 1.0) / 0.0001;
 
-	v = pow(dst->highPassFilter.cuttofSweep_sec, 1.0 / SAMPLES);
-	dst->highPassFilter.cuttofSweep_sec =  (v - 1.0) / 0.0003;
+		v =  (100 - dst->lowPassFilter.resonancePercent) / 11.0;
+		dst->lowPassFilter.resonancePercent =  sqrt((1.0 / (v / 5.0) - 1) / 20);
+	}
 
-	if(isnormal(dst->frequency.slideOctaves_s) == 0)
-		dst->frequency.slideOctaves_s = 0;
+	if(groups & sfxr_GroupHighPass)
+	{
+		v = dst->highPassFilter.cutoffFrequencyHz / (dst->highPassFilter.cutoffFrequencyHz + (8 * SAMPLES));
+		dst->highPassFilter.cutoffFrequencyHz = sqrt(v * 10.0);
 
-	if(isnormal(dst->frequency.slideOctaves_s2) == 0)
-		dst->frequency.slideOctaves_s2 = 0;
+		v = pow(dst->highPassFilter.cuttofSweep_sec, 1.0 / SAMPLES);
+		dst->highPassFilter.cuttofSweep_sec =  (v - 1.0) / 0.0003;
+	}
 
 	return 0;
 }
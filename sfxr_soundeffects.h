@@ -6,6 +6,21 @@
 
 #define INCLUDE_SAMPLES 1
 #define INCLUDE_WAV_EXPORT 1
+// needs pthreads, off unless the build asks for it (the cmake build does, sfxr_bank uses it)
+#ifndef INCLUDE_BATCH_EXPORT
+#define INCLUDE_BATCH_EXPORT 0
+#endif
+// needs mmap, same as above
+#ifndef INCLUDE_SOUND_BANK
+#define INCLUDE_SOUND_BANK 0
+#endif
+#define INCLUDE_RENDER_CACHE 1
+#define INCLUDE_MIXER 1
+#define INCLUDE_SEQUENCER 1
+// exports the slow reference implementations sfxr_golden and sfxr_bench measure against (the cmake build does)
+#ifndef SFXR_UNIT_TESTS
+#define SFXR_UNIT_TESTS 0
+#endif
 
 #ifdef __cplusplus
 extern "C" {
@@ -22,6 +37,7 @@ void UnitTestMidiHelpers();
 typedef struct sfxr_Settings sfxr_Settings;
 typedef struct sfxr_Model sfxr_Model;
 typedef struct sfxr_Data sfxr_Data;
+typedef struct sfxr_Wavetable sfxr_Wavetable;
 
 #if INCLUDE_SAMPLES
 	int sfxr_Mutate(sfxr_Settings * dst, sfxr_Settings const* src);
@@ -35,51 +51,366 @@ typedef struct sfxr_Data sfxr_Data;
 
 	int sfxr_Randomize(sfxr_Settings * dst);
 	void sfxr_UnitTestTranslationFunctions();
+// compares the polynomial sine of the band limited oscillator and its vibrato with libm, returns the number of points out of bounds
+	int sfxr_UnitTestFastSin(FILE * file);
 #endif
 
 #if INCLUDE_WAV_EXPORT
-//wav freq can't actually change based on the original code
-// currently wav_bits must be 8,16, or 32 and sample rate must be <= 44100
+// sounds are synthesized at sample_rate up to 44100 (see sfxr_ModelInitRate), higher rates (up to
+// SFXR_MAX_SAMPLE_RATE) are synthesized at 44100 and resampled
+// wav_bits must be 8, 16, 24 (integer pcm) or 32 (ieee float)
 // for playback use 16/44100
 // for audio mixing/editing use 32/44100
 	int sfxr_ExportWAV(sfxr_Settings const*, int wav_bits, int sample_rate, const char* filename);
 // sprintf filename convenience function
 	int sfxr_ExportWAV_F(sfxr_Settings const*, int wav_bits, int sample_rate, const char* filename_format, ...);
+// stereo, pan goes from -1 (left) to 1 (right) with the same equal power law as the mixer
+	int sfxr_ExportWAVPanned(sfxr_Settings const*, int wav_bits, int sample_rate, float pan, const char* filename);
+
+// streaming writer for interleaved float frames, e.g. for recording the output of a sfxr_Mixer.
+// wav_bits as for sfxr_ExportWAV, 24 bit or more than 2 channels gets a WAVE_FORMAT_EXTENSIBLE header
+// (channels are assigned in the usual wave order, up to 7.1). the sizes are filled in by sfxr_WavClose.
+#define SFXR_WAV_MAX_CHANNELS 8
+#define SFXR_WAV_HEADER_MAX 80
+
+typedef struct sfxr_WavWriter
+{
+	FILE * file;
+	int wav_bits;
+	int channels;
+	int sample_rate;
+	unsigned int frames;
+} sfxr_WavWriter;
+
+	int sfxr_WavOpen(sfxr_WavWriter * writer, const char * filename, int wav_bits, int channels, int sample_rate);
+// count is in frames, frames holds count*channels floats
+	int sfxr_WavWrite(sfxr_WavWriter * writer, float const* frames, int count);
+	int sfxr_WavClose(sfxr_WavWriter * writer);
+
+#if INCLUDE_BATCH_EXPORT
+// exports settings[i] to filenames[i] for every i < count, spread over a pool of threads
+// (threads <= 0 uses one per core). each worker renders through its own stack buffers.
+// returns the number of files that failed to export, or negative if there was a problem
+	int sfxr_ExportBank(sfxr_Settings const* settings, const char * const* filenames, int count, int wav_bits, int sample_rate, int threads);
+#endif
+
+#if INCLUDE_SOUND_BANK
+/*
+ * A sound bank is one file holding many rendered sounds, so a game can load all of them with a single mmap.
+ *
+ * layout: "SFXB", version, count, sizeof(sfxr_BankEntry) as little endian 32 bit ints,
+ * then count entries sorted by name_hash with their fields little endian in the order below,
+ * then the pcm of every sound starting on a 64 byte boundary, its samples little endian whatever the host
+ * (what sfxr_BankOpen maps is the file as is, a big endian host has to swap them itself).
+ */
+typedef struct sfxr_BankEntry
+{
+	unsigned long long name_hash;  // sfxr_BankHash of the name
+	unsigned long long offset;	   // of the pcm from the start of the file
+	unsigned int length;		   // of the pcm in bytes
+	unsigned short bits;		   // 8 (unsigned), 16, 24 (packed) or 32 (float)
+	unsigned short channels;
+	unsigned int sample_rate;
+	unsigned int reserved;
+} sfxr_BankEntry;
+
+typedef struct sfxr_Bank
+{
+	void const* mapping;
+	unsigned long long size;
+	sfxr_BankEntry const* entries;
+	int count;
+} sfxr_Bank;
+
+// 64 bit FNV-1a
+	unsigned long long sfxr_BankHash(const char * name);
+
+// renders settings[i] under names[i] for every i < count, wav_bits and sample_rate as for sfxr_ExportWAV
+// fails (and removes the file) if two names hash the same
+	int sfxr_WriteBank(const char * filename, sfxr_Settings const* settings, const char * const* names, int count, int wav_bits, int sample_rate);
+
+// maps the file read only, entries and samples point straight into the mapping until sfxr_BankClose
+	int sfxr_BankOpen(sfxr_Bank * bank, const char * filename);
+	void sfxr_BankClose(sfxr_Bank * bank);
+
+// binary search on the hash, returns null if there's no such sound
+	sfxr_BankEntry const* sfxr_BankFind(sfxr_Bank const* bank, const char * name);
+	void const* sfxr_BankSamples(sfxr_Bank const* bank, sfxr_BankEntry const* entry);
+#endif
 #endif
 	
 // debug function used to view current state of the settings
 // i will not add a settings from json function.
 int sfxr_SettingsToJson(FILE *, sfxr_Settings * data);
+
+/*
+ * compact versioned binary form of an array of settings, so parameters can be shipped instead of pcm.
+ * "SFXS", version, fields per record, 2 reserved bytes, record count as a little endian uint32;
+ * then per record the wave type as one byte, a bit mask of which fields are non zero,
+ * and the non zero fields as little endian floats. a typical preset takes around 50 bytes.
+ */
+// returns the number of bytes the settings need, they are only written if that fits in capacity.
+size_t sfxr_SettingsPack(void * dst, size_t capacity, sfxr_Settings const* settings, int count);
+int sfxr_SettingsToBinary(FILE *, sfxr_Settings const* settings, int count);
+// decodes straight out of src (which may be a mapped file), no intermediate copies.
+// returns the number of records in src (even if more than max were there), or negative if src isn't valid, e.g. an unknown wave type
+int sfxr_SettingsUnpack(sfxr_Settings * dst, int max, void const* src, size_t size);
 	
-// crush down to desired bit rate (creates PCM wave audio, so the uint8 isn't 2's compliment)
-// assumes dst is big enough
-// TODO: add SIMD	
-int sfxr_Quantize8(unsigned char * dst, float* src, int src_length);
-int sfxr_Quantize16(unsigned short * dst, float* src, int src_length);
+// sample formats, the values are the bits per sample
+enum sfxr_SampleFormat
+{
+	sfxr_U8  = 8,  // unsigned, 128 is silence (what 8 bit wav uses)
+	sfxr_S16 = 16,
+	sfxr_S24 = 24, // packed little endian, 3 bytes a sample
+	sfxr_F32 = 32
+};
+
+// triangular dither generator, one xorshift per simd lane
+#define SFXR_DITHER_LANES 16
 
+typedef struct sfxr_Dither
+{
+	unsigned int state[SFXR_DITHER_LANES];
+} sfxr_Dither;
+
+int sfxr_DitherInit(sfxr_Dither * dither, unsigned int seed);
+
+// crush down to desired bit rate, saturating and rounding to nearest.
+// if dither isn't null +-1 lsb of triangular noise is added first (f32 is only clamped to [-1, 1]).
+// dst may be src, assumes dst is big enough. returns samples written
+int sfxr_Quantize(void * dst, float const* src, int src_length, enum sfxr_SampleFormat format, sfxr_Dither * dither);
+// sfxr_Quantize without dither
+int sfxr_Quantize8(unsigned char * dst, float const* src, int src_length);
+int sfxr_Quantize16(short * dst, float const* src, int src_length);
+
+// resamples src to dst_sample_rate with sfxr_Resampler, despite the name it can go up as well as down.
+// dst may be src only when downsampling.
 // returns samples written (or negative if there was a problem)
 int sfxr_Downsample(float * dst, int dst_length, float* src, int src_length, int dst_sample_rate, int src_sample_rate);
 
 int sfxr_Init(sfxr_Settings * dst);
 int sfxr_ModelInit(sfxr_Model * model, sfxr_Settings const* settings);
+// same as sfxr_ModelInit but the sound is synthesized directly at sample_rate: every time constant is rescaled
+// so it lasts as long and sits at the same pitch, rendering at 22050 costs half what 44100 does.
+// it is an approximation of the 44100 sound, not a bit exact match of it resampled
+int sfxr_ModelInitRate(sfxr_Model * model, sfxr_Settings const* settings, int sample_rate);
 int sfxr_DataInit(sfxr_Data * data, sfxr_Model const* model);
 
+// the members of sfxr_Settings, for saying which ones changed
+enum sfxr_SettingsGroup
+{
+	sfxr_GroupWaveType		= 1 << 0,
+	sfxr_GroupEnvelope		= 1 << 1,
+	sfxr_GroupFrequency		= 1 << 2,
+	sfxr_GroupVibrato		= 1 << 3,
+	sfxr_GroupArpeggiation	= 1 << 4,
+	sfxr_GroupDuty			= 1 << 5,
+	sfxr_GroupRetrigger		= 1 << 6,
+	sfxr_GroupFlanger		= 1 << 7,
+	sfxr_GroupLowPass		= 1 << 8,
+	sfxr_GroupHighPass		= 1 << 9,
+	sfxr_GroupAll			= (1 << 10) - 1
+};
+
+// which groups differ between a and b
+unsigned int sfxr_SettingsDiff(sfxr_Settings const* a, sfxr_Settings const* b);
+// for live editing: recomputes only what the groups of settings in groups turn into, at the model's sample rate.
+// voices playing the model pick up everything they read from it on their next block.
+// mixer voices play a copy of the model, update them with sfxr_MixerUpdate instead.
+int sfxr_ModelUpdate(sfxr_Model * model, sfxr_Settings const* settings, unsigned int groups);
+// moves a playing voice onto the values it copied from its model when it started (base pitch, slide,
+// filter cutoffs, duty, flanger offset) for the groups that were updated, without restarting it
+int sfxr_DataUpdate(sfxr_Data * data, unsigned int groups);
+
+/*
+ * Automation, for driving a playing voice from gameplay (engine rpm into pitch, distance into the low pass...).
+ *
+ * A curve is a single producer/single consumer ring of breakpoints in memory the caller provides,
+ * each one ramps linearly from where the last ended to its value over its length in samples.
+ * When it runs dry it holds the last value. One curve drives one voice.
+ *
+ * The voice reads its curves every SFXR_AUTOMATION_BLOCK samples and interpolates linearly in between,
+ * so the cost is a few adds a sample and there's no zipper noise.
+ */
+#define SFXR_AUTOMATION_BLOCK 64
+
+enum sfxr_AutomationTarget
+{
+	sfxr_AutomateVolume,	// gain, 1 leaves it alone
+	sfxr_AutomatePitch,		// frequency multiplier, 1 leaves it alone
+	sfxr_AutomateLowPass,	// cutoff in hz, replaces the model's cutoff and sweep
+	sfxr_AutomateHighPass,	// cutoff in hz, replaces the model's cutoff
+	sfxr_AutomateDuty,		// square duty cycle in percent, replaces the model's duty and sweep
+	sfxr_AutomateFlanger,	// offset in ms, replaces the model's offset and sweep
+	sfxr_AutomateTargets
+};
+
+typedef struct sfxr_Breakpoint
+{
+	float value;
+	unsigned int samples; // to ramp over, 0 jumps
+} sfxr_Breakpoint;
+
+typedef struct sfxr_Curve
+{
+	sfxr_Breakpoint * points;
+	unsigned int mask;
+
+// head is only written by the producer, the rest by the consumer
+	unsigned int head;
+	char padding[64];
+	unsigned int tail;
+	unsigned int elapsed;
+	float from;
+	float value;
+} sfxr_Curve;
+
+typedef struct sfxr_Automation
+{
+	sfxr_Curve * curves[sfxr_AutomateTargets];
+	float value[sfxr_AutomateTargets];
+	float step[sfxr_AutomateTargets];
+	int remaining;
+	sfxr_Model const* model; // of the voice it was last attached to
+} sfxr_Automation;
+
+// capacity must be a power of 2, the curve starts out holding value
+int sfxr_CurveInit(sfxr_Curve * curve, sfxr_Breakpoint * points, int capacity, float value);
+// producer side, returns negative if the ring is full
+int sfxr_CurvePush(sfxr_Curve * curve, float value, unsigned int samples);
+
+int sfxr_AutomationInit(sfxr_Automation * automation);
+// curve may be null to stop automating target. a curve set while attached starts from the value it holds
+int sfxr_AutomationSet(sfxr_Automation * automation, enum sfxr_AutomationTarget target, sfxr_Curve * curve);
+// attaches automation to a voice (null detaches it), after sfxr_DataInit/sfxr_DataNoteOn which detach it.
+// the automation has to stay alive while it's attached
+int sfxr_DataAutomate(sfxr_Data * data, sfxr_Automation * automation);
+
+/*
+ * The phaser's delay line is bigger than the rest of a voice ten times over and most sounds never use it.
+ * By default it's part of sfxr_Data. Define SFXR_COMPACT_VOICES as 1 (for the library and everything
+ * including this) to take it out: sfxr_DataInit/sfxr_DataNoteOn then leave a voice without one, which renders
+ * exactly like a voice whose flanger is off. A voice with a flanger gets one attached afterwards
+ * (after sfxr_DataAutomate/sfxr_DataUpdate too, if they turn the flanger on), either memory of its own
+ * or from a pool. Until it has one it plays without its flanger.
+ */
+#ifndef SFXR_COMPACT_VOICES
+#define SFXR_COMPACT_VOICES 0
+#endif
+#ifndef SFXR_PHASER_LENGTH
+#define SFXR_PHASER_LENGTH 1024 // power of 2 and at least 16, flanger offsets past it are clamped
+#endif
+
+// nonzero if the voice's flanger is on, so it needs a delay line
+int sfxr_DataNeedsPhaser(sfxr_Data const* data);
+// attaches buffer (SFXR_PHASER_LENGTH floats, cleared here) if the voice needs it, null detaches.
+// returns 1 if attached, 0 if it wasn't needed. without SFXR_COMPACT_VOICES the voice keeps its own and buffer is unused
+int sfxr_DataSetPhaser(sfxr_Data * data, float * buffer);
+
+// delay lines shared by a number of voices, in memory the caller provides. not thread safe.
+typedef struct sfxr_PhaserPool
+{
+	float (*buffers)[SFXR_PHASER_LENGTH];
+	int count;
+	int free; // first free buffer, each free buffer holds the index of the next in its first float
+	int used;
+	unsigned long long misses; // voices that needed one when there were none left
+} sfxr_PhaserPool;
+
+int sfxr_PhaserPoolInit(sfxr_PhaserPool * pool, float (*buffers)[SFXR_PHASER_LENGTH], int count);
+// attaches a delay line from pool if the voice needs one. returns 1 if it has one (maybe already),
+// 0 if it wasn't needed, negative if the pool is empty
+int sfxr_DataTakePhaser(sfxr_Data * data, sfxr_PhaserPool * pool);
+// gives the voice's delay line back to pool if it came from there, before the voice is reused or once it's finished
+int sfxr_DataReleasePhaser(sfxr_Data * data, sfxr_PhaserPool * pool);
+
+// noise voices draw from a generator owned by the data, sfxr_DataInit seeds it with 0.
+// the same seed renders the same sound on any thread. the mixer and sequencer give every voice they start its own seed.
+int sfxr_DataSeed(sfxr_Data * data, unsigned int seed);
+// seeds the generator the preset functions (sfxr_Coin... sfxr_Randomize, sfxr_Mutate) use on the calling thread.
+void sfxr_Seed(unsigned int seed);
+
+// note mode, for playing one model as an instrument.
+// sfxr_DataNoteOn restarts data at the pitch of the midi key (see MidiKeyToFrequency) instead of the model's base frequency,
+// the slide, arpeggio and frequency limit move with it. the sustain stage is held until sfxr_DataNoteOff,
+// which goes into the decay from wherever the envelope is. the model is never touched so any number of notes can share it.
+int sfxr_DataNoteOn(sfxr_Data * data, sfxr_Model const* model, int key);
+int sfxr_DataNoteOff(sfxr_Data * data);
+// retunes a playing sound (glides, pitch bends) without restarting it
+int sfxr_DataSetFrequency(sfxr_Data * data, float hz);
+
 // the library this is forked from always uses a sample rate of 44100
 // ergo divide by 44100 to get time in seconds.
+// a held note is counted as if it were released where the sustain stage would have ended.
 int sfxr_ComputeRemainingSamples(sfxr_Data const* data);
+#if SFXR_UNIT_TESTS
+// the same by stepping the slide every sample, what sfxr_ComputeRemainingSamples has to agree with
+int sfxr_ComputeRemainingSamplesStepped(sfxr_Data const* data);
+#endif
 
 // use one of buffer or short buffer to get samples out
 // 12 bits per sample is the limit of human hearing, but for mixing/editing etc you want full 32 bit floating samples.
 // for those purposes you should also use 192khz though; but this library can't do more than 44.1khz (the limit of human hearing is 40khz)
 int sfxr_DataSynthSample(sfxr_Data * data, int length, float* buffer);
 
+// renders several voices at once, 4/8/16 at a time depending on SSE2/AVX2/AVX-512 support.
+// buffers[i] receives the samples of data[i] and written[i] how many, exactly what
+// sfxr_DataSynthSample(data[i], length, buffers[i]) would have produced.
+// returns 0, or negative if there was a problem
+int sfxr_DataSynthSampleMulti(sfxr_Data ** data, int voices, int length, float ** buffers, int * written);
+
 	
 enum sfxr_WaveType
 {
 	sfxr_Square,
 	sfxr_Sawtooth,
 	sfxr_Sine,
-	sfxr_Noise
+	sfxr_Noise,
+// plays the sfxr_Wavetable given to the model with sfxr_ModelSetWavetable, silent without one.
+// anything that builds its own model from settings (like sfxr_ExportWAV or sfxr_CacheRender) has no table,
+// hand a model to sfxr_MixerTriggerModel or sfxr_SequencerSetInstrumentModel instead
+	sfxr_Table
+};
+
+/*
+ * A single cycle waveform mip-mapped an octave a level: level k is length>>k samples long and only
+ * has the harmonics that fit in it, the oscillator picks the level whose harmonics all fit under nyquist
+ * at the pitch being played and interpolates linearly between samples.
+ *
+ * The levels live in an arena of floats the caller owns, any number of models can share a table
+ * and any number of tables can be carved out of one arena. It's only read once built.
+ */
+#define SFXR_WAVETABLE_MIN_LENGTH 4
+#define SFXR_WAVETABLE_MAX_LENGTH 4096
+
+struct sfxr_Wavetable
+{
+	float const* levels; // one after the other, longest first
+	int length;
+	int shift; // log2(length)
+	int level_count;
+};
+
+// floats of arena a table of length samples needs
+int sfxr_WavetableSize(int length);
+// builds table in arena from one cycle of cycle_length samples in [-1, 1]. each sample is held for
+// length/cycle_length table samples, so a 32 step nes triangle or game boy wave keeps its steps.
+// length is a power of 2 from SFXR_WAVETABLE_MIN_LENGTH to SFXR_WAVETABLE_MAX_LENGTH, dc is removed.
+// returns floats of arena used, or negative if there was a problem
+int sfxr_WavetableInit(sfxr_Wavetable * table, float * arena, int arena_length, float const* cycle, int cycle_length, int length);
+// the table sfxr_Table reads, after sfxr_ModelInit/sfxr_ModelInitRate which clear it.
+// table has to stay alive as long as the model
+int sfxr_ModelSetWavetable(sfxr_Model * model, sfxr_Wavetable const* table);
+
+// how the waveform is turned into samples, stored in sfxr_Model::oscillator
+enum sfxr_Oscillator
+{
+// the original 8x supersampled oscillator/filter/phaser loop, bit exact with sfxr; use it for offline export.
+	sfxr_Supersampled,
+// PolyBLEP square and saw, polynomial sine and vibrato (see sfxr_UnitTestFastSin),
+// filters and phaser run once per output sample.
+// roughly 8x cheaper but not bit exact, meant for real-time playback.
+	sfxr_BandLimited
 };
 	
 
@@ -90,7 +421,8 @@ struct sfxr_Settings
 // length of the sound effect is essentially attack + sustain + decay
 // but it can be cut off early by the frequency decaying below the frequency.limitHz
 // this is further affected by arpeggation which is further affected by retrigger
-// basically when making music change the sustainSec to make the note longer/shorter
+// basically when making music change the sustainSec to make the note longer/shorter,
+// or play the model with sfxr_DataNoteOn/sfxr_DataNoteOff which hold the sustain until the note is released
 	struct {
 		float attackSec; // Attack is the beginning of the sound, longer attack means a smoother start.
 		float sustainSec; // Sustain is how long the volume is held constant before fading out.
@@ -181,13 +513,25 @@ struct sfxr_Model
 
 	int env_length[3];
 	int rep_limit;
+	int sample_rate;
+// samples at 44100 per synthesized sample
+	float time_scale;
 	int wave_type;
-	float square_duty;
+// sfxr_Supersampled after sfxr_ModelInit, set it to sfxr_BandLimited afterwards for the fast path
+	int oscillator;
+	sfxr_Wavetable const* wavetable;
+	float square_duty; // where the duty starts, each voice sweeps its own copy
 	float square_slide;
 	float fdphase;
 	float fltw_d;
 	float fltdmp;
+// filter coefficients are per step, so their limits move with the sample rate
+	float fltw_max;
+	float flthp_min;
+	float flthp_max;
 	float flthp_d;
+// the low pass sweep for one step of the band limited oscillator (8 supersampled steps folded into one)
+	float bl_fltw_d;
 	float vib_speed;
 	float vib_amp;
 	double arp_mod;
@@ -223,10 +567,381 @@ struct sfxr_Data
 	float env_vol;
 	double fperiod;
 	double fslide;
+// what fperiod resets to, and the limit, the model's unless a note changed them
+	double base_period;
+	double fmaxperiod;
+// how far a note moved them
+	double transpose;
+// nonzero while a note is held in the sustain stage
+	int held;
+	struct sfxr_Automation * automation;
+	unsigned int noise_seed;
+	unsigned int noise_counter;
 	float noise_buffer[32];
-	float phaser_buffer[1024];
+#if SFXR_COMPACT_VOICES
+// SFXR_PHASER_LENGTH floats, null without a flanger (see sfxr_DataSetPhaser)
+	float * phaser_buffer;
+#else
+	float phaser_buffer[SFXR_PHASER_LENGTH];
+#endif
 };
 
+/*
+ * Windowed sinc resampler for getting the 44100 synth output to whatever rate the device runs at.
+ * The kernel is tabulated at SFXR_RESAMPLER_PHASES fractional offsets and interpolated between them,
+ * so any pair of rates works, up or down. Keeps its history between calls so a sound can be streamed
+ * through it a block at a time, channels are interleaved.
+ */
+#define SFXR_RESAMPLER_TAPS 32
+#define SFXR_RESAMPLER_PHASES 128
+#define SFXR_RESAMPLER_CHANNELS 2
+#define SFXR_MAX_SAMPLE_RATE 192000
+
+typedef struct sfxr_Resampler
+{
+	float coefficients[(SFXR_RESAMPLER_PHASES+1)*SFXR_RESAMPLER_TAPS];
+// every input is written twice so the newest SFXR_RESAMPLER_TAPS are always contiguous
+	float history[SFXR_RESAMPLER_CHANNELS][2*SFXR_RESAMPLER_TAPS];
+	int channels;
+	int write;
+// positions in input samples, 32.32 fixed point
+	unsigned long long step;
+	unsigned long long time;
+	unsigned long long filled;
+} sfxr_Resampler;
+
+int sfxr_ResamplerInit(sfxr_Resampler * resampler, int dst_sample_rate, int src_sample_rate, int channels);
+// how many more input frames it takes to get frames more output frames
+int sfxr_ResamplerInputNeeded(sfxr_Resampler const* resampler, int frames);
+// consumes src until dst is full, returns frames written and stores frames read in consumed (if not null).
+// dst may be src when downsampling, it never gets ahead of the read position.
+int sfxr_ResamplerRun(sfxr_Resampler * resampler, float * dst, int dst_frames, float const* src, int src_frames, int * consumed);
+// feeds silence until everything up to the last input has been written, returns frames written
+int sfxr_ResamplerFlush(sfxr_Resampler * resampler, float * dst, int dst_frames);
+
+#if INCLUDE_RENDER_CACHE
+/*
+ * Keeps rendered sounds around so triggering the same settings again is a lookup instead of a render.
+ *
+ * The caller provides the memory: an arena of floats the pcm lives in, and the table of entries.
+ * When either is full the least recently used sound nobody holds is evicted.
+ * Not thread safe, guard it or use one cache per thread.
+ */
+typedef struct sfxr_CacheEntry
+{
+	sfxr_Settings settings;
+	unsigned long long hash;
+	unsigned long long last_used;
+	int sample_rate;
+	int offset;
+	int length;
+	int refs;
+} sfxr_CacheEntry;
+
+typedef struct sfxr_Cache
+{
+	float * arena;
+	int arena_length;
+	sfxr_CacheEntry * entries;
+	int max_entries;
+	int count;
+
+	unsigned long long clock;
+	unsigned long long hits;
+	unsigned long long misses;
+	unsigned long long evictions;
+} sfxr_Cache;
+
+int sfxr_CacheInit(sfxr_Cache * cache, float * arena, int arena_length, sfxr_CacheEntry * entries, int max_entries);
+
+// returns the sound as floats at sample_rate and its length, rendering it if it isn't cached.
+// the buffer is shared, don't write to it, and stays valid until it's given back with sfxr_CacheRelease.
+// returns null if it can't fit even after evicting everything not held.
+float const* sfxr_CacheRender(sfxr_Cache * cache, sfxr_Settings const* settings, int sample_rate, int * length);
+int sfxr_CacheRelease(sfxr_Cache * cache, float const* samples);
+#endif
+
+#if INCLUDE_MIXER
+/*
+ * Fixed size pool of voices mixed down to interleaved stereo, meant to be driven from the audio callback.
+ * Nothing is allocated, every voice owns its model and data so the mixer must not be moved or copied
+ * once voices are playing. The cost of a block is bounded by SFXR_MIXER_VOICES voices.
+ */
+#ifndef SFXR_MIXER_VOICES
+#define SFXR_MIXER_VOICES 32
+#endif
+// with SFXR_COMPACT_VOICES, voices playing a flanger at once. a flanger voice triggered (or updated into one)
+// when they're all taken still plays, but dry for the rest of its life, and counts in phaser_pool.misses
+#ifndef SFXR_MIXER_PHASERS
+#define SFXR_MIXER_PHASERS (SFXR_MIXER_VOICES/4)
+#endif
+
+enum sfxr_StealPolicy
+{
+	sfxr_StealOldest, // a trigger on a full mixer replaces the voice that started longest ago
+	sfxr_StealNone	  // a trigger on a full mixer fails
+};
+
+typedef struct sfxr_MixerVoice
+{
+	sfxr_Model model;
+	sfxr_Data data;
+	float gain;
+	float pan;
+	float left;
+	float right;
+	float pitch; // the model was transposed by, updates are too
+	unsigned long long started;
+	int handle;
+	int active;
+} sfxr_MixerVoice;
+
+#ifndef SFXR_QUEUE_LENGTH
+#define SFXR_QUEUE_LENGTH 256 // must be a power of 2
+#endif
+#define SFXR_MIXER_QUEUES 8
+
+enum sfxr_CommandType
+{
+	sfxr_CommandTrigger,
+	sfxr_CommandStop,
+	sfxr_CommandSetVoice,
+	sfxr_CommandUpdate
+};
+
+typedef struct sfxr_Command
+{
+	int type;
+	int handle;
+	float gain;
+	float pan;
+	float pitch;
+	unsigned int groups;
+	sfxr_Model model;
+} sfxr_Command;
+
+/*
+ * Wait free single producer/single consumer ring for starting and stopping voices from a game thread
+ * while the audio thread is mixing. Give every producing thread its own queue and attach all of them
+ * to the mixer, sfxr_MixerMix drains them at the start of every block.
+ *
+ * the model is built (and transposed) on the producing thread so the audio thread only copies it.
+ */
+typedef struct sfxr_CommandQueue
+{
+	sfxr_Command commands[SFXR_QUEUE_LENGTH];
+
+// head is only written by the producer and tail by the consumer, kept on separate cache lines
+	unsigned int head;
+	int handle_base; // set by sfxr_MixerAttach, every attached queue hands out its own handles
+	int next_handle;
+	unsigned long long dropped;
+	char padding[64];
+	unsigned int tail;
+} sfxr_CommandQueue;
+
+typedef struct sfxr_Mixer
+{
+	sfxr_MixerVoice voices[SFXR_MIXER_VOICES];
+#if SFXR_COMPACT_VOICES
+	float phasers[SFXR_MIXER_PHASERS][SFXR_PHASER_LENGTH];
+#endif
+	sfxr_PhaserPool phaser_pool; // empty without SFXR_COMPACT_VOICES
+	sfxr_CommandQueue * queues[SFXR_MIXER_QUEUES];
+	int queue_count;
+	int output_rate;
+	sfxr_Resampler resampler;
+	int policy;
+	int next_handle;
+	unsigned long long clock;
+
+	unsigned long long triggers;
+	unsigned long long steals;
+	unsigned long long rejected;
+} sfxr_Mixer;
+
+int sfxr_MixerInit(sfxr_Mixer * mixer, enum sfxr_StealPolicy policy);
+
+// pan is -1 (left) to 1 (right). returns a handle to the voice or negative if no voice was free.
+// with SFXR_COMPACT_VOICES a voice that finds no free delay line doesn't fail, it plays without its flanger
+int sfxr_MixerTrigger(sfxr_Mixer * mixer, sfxr_Settings const* settings, float gain, float pan);
+// skips sfxr_ModelInit, the model is copied into the voice
+int sfxr_MixerTriggerModel(sfxr_Mixer * mixer, sfxr_Model const* model, float gain, float pan);
+int sfxr_MixerSetVoice(sfxr_Mixer * mixer, int handle, float gain, float pan);
+// for live editing a playing voice, which plays its own copy of the model so sfxr_ModelUpdate doesn't reach it.
+// the voice switches to the model of settings (or to model) transposed as it was started, then sfxr_DataUpdate
+// moves it on for the groups that changed (see sfxr_SettingsDiff)
+int sfxr_MixerUpdate(sfxr_Mixer * mixer, int handle, sfxr_Settings const* settings, unsigned int groups);
+int sfxr_MixerUpdateModel(sfxr_Mixer * mixer, int handle, sfxr_Model const* model, unsigned int groups);
+int sfxr_MixerStop(sfxr_Mixer * mixer, int handle);
+int sfxr_MixerActiveVoices(sfxr_Mixer const* mixer);
+
+// voices are synthesized at 44100, anything else goes through the mixer's resampler. defaults to 44100
+int sfxr_MixerSetOutputRate(sfxr_Mixer * mixer, int sample_rate);
+// overwrites out with frames of interleaved stereo (2*frames floats) at the output rate
+int sfxr_MixerMix(sfxr_Mixer * mixer, float * out, int frames);
+
+int sfxr_QueueInit(sfxr_CommandQueue * queue);
+// producer side; pitch multiplies the frequency (1 leaves it alone).
+// returns the handle the voice will have, or negative if the queue is full
+int sfxr_QueueTrigger(sfxr_CommandQueue * queue, sfxr_Settings const* settings, float gain, float pan, float pitch);
+int sfxr_QueueTriggerModel(sfxr_CommandQueue * queue, sfxr_Model const* model, float gain, float pan, float pitch);
+int sfxr_QueueStop(sfxr_CommandQueue * queue, int handle);
+int sfxr_QueueSetVoice(sfxr_CommandQueue * queue, int handle, float gain, float pan);
+int sfxr_QueueUpdate(sfxr_CommandQueue * queue, int handle, sfxr_Settings const* settings, unsigned int groups);
+int sfxr_QueueUpdateModel(sfxr_CommandQueue * queue, int handle, sfxr_Model const* model, unsigned int groups);
+
+// consumer side; sfxr_MixerMix drains attached queues itself, sfxr_MixerDrain is for doing it by hand.
+// attach a queue before its producer starts triggering, that's when it gets its range of handles
+int sfxr_MixerAttach(sfxr_Mixer * mixer, sfxr_CommandQueue * queue);
+int sfxr_MixerDrain(sfxr_Mixer * mixer, sfxr_CommandQueue * queue);
+#endif
+
+#if INCLUDE_SEQUENCER
+/*
+ * Plays a song given as a list of note events through a fixed pool of voices, rendering interleaved stereo.
+ * Every instrument is a model synthesized directly at the sequencer's sample rate (see sfxr_ModelInitRate),
+ * notes start and end with sfxr_DataNoteOn/sfxr_DataNoteOff on the exact sample of their tick.
+ *
+ * Only the voices an event lands on are split at it, the rest of a block goes through
+ * sfxr_DataSynthSampleMulti in one piece however dense the song is.
+ * Nothing is allocated, voices point at the instruments so the sequencer must not be moved once it's playing.
+ */
+#ifndef SFXR_SEQUENCER_VOICES
+#define SFXR_SEQUENCER_VOICES 32
+#endif
+// with SFXR_COMPACT_VOICES, notes playing a flanger at once. a note that starts when they're all taken
+// still plays, but dry, and counts in phaser_pool.misses
+#ifndef SFXR_SEQUENCER_PHASERS
+#define SFXR_SEQUENCER_PHASERS (SFXR_SEQUENCER_VOICES/4)
+#endif
+#ifndef SFXR_SEQUENCER_INSTRUMENTS
+#define SFXR_SEQUENCER_INSTRUMENTS 32
+#endif
+#define SFXR_SEQUENCER_CHANNELS 16
+
+typedef struct sfxr_Event
+{
+	unsigned int tick;			// from the start of the song
+	unsigned char channel;		// picks the gain and pan, and which note a release applies to
+	unsigned char instrument;
+	unsigned char key;			// midi key
+	unsigned char velocity;		// 1-127, 0 releases the key held on the channel
+} sfxr_Event;
+
+typedef struct sfxr_SequencerVoice
+{
+	sfxr_Data data;
+	float left;
+	float right;
+	unsigned long long started;
+	int channel;
+	int key;
+	int active;
+	int rendered; // samples of the current block already mixed
+} sfxr_SequencerVoice;
+
+typedef struct sfxr_Sequencer
+{
+	sfxr_SequencerVoice voices[SFXR_SEQUENCER_VOICES];
+#if SFXR_COMPACT_VOICES
+	float phasers[SFXR_SEQUENCER_PHASERS][SFXR_PHASER_LENGTH];
+#endif
+	sfxr_PhaserPool phaser_pool; // empty without SFXR_COMPACT_VOICES
+	sfxr_Model instruments[SFXR_SEQUENCER_INSTRUMENTS];
+	unsigned char loaded[SFXR_SEQUENCER_INSTRUMENTS];
+	float channel_gain[SFXR_SEQUENCER_CHANNELS];
+	float channel_pan[SFXR_SEQUENCER_CHANNELS];
+
+	int sample_rate;
+	double samples_per_tick;
+// where the tempo last changed, so a change doesn't move what was already played
+	double tempo_tick;
+	unsigned long long tempo_sample;
+	unsigned long long position;
+	unsigned long long clock;
+
+	unsigned long long notes;
+	unsigned long long steals;
+	unsigned long long ignored;
+} sfxr_Sequencer;
+
+int sfxr_SequencerInit(sfxr_Sequencer * sequencer, int sample_rate, double ticks_per_second);
+int sfxr_SequencerSetInstrument(sfxr_Sequencer * sequencer, int instrument, sfxr_Settings const* settings);
+// skips sfxr_ModelInitRate, the model is copied (wavetable and all) and has to be at the sequencer's sample rate
+int sfxr_SequencerSetInstrumentModel(sfxr_Sequencer * sequencer, int instrument, sfxr_Model const* model);
+// pan is -1 (left) to 1 (right), channels start at gain 1 and centered
+int sfxr_SequencerSetChannel(sfxr_Sequencer * sequencer, int channel, float gain, float pan);
+// takes effect from the current position
+int sfxr_SequencerSetTempo(sfxr_Sequencer * sequencer, double ticks_per_second);
+
+// overwrites out with frames of interleaved stereo, playing the events whose tick falls inside them.
+// events must be sorted by tick, any that are already late play at the start.
+// stores how many events were played in consumed (if not null, 0 on failure), hand the rest to the next call.
+// with no frames it just plays the events that are due at the current position.
+int sfxr_SequencerRender(sfxr_Sequencer * sequencer, float * out, int frames, sfxr_Event const* events, int count, int * consumed);
+// lets every held note go into its decay
+int sfxr_SequencerReleaseAll(sfxr_Sequencer * sequencer);
+int sfxr_SequencerActiveVoices(sfxr_Sequencer const* sequencer);
+
+#if INCLUDE_WAV_EXPORT
+// renders the song from the current position into a stereo wav at the sequencer's sample rate until every note has
+// died away, notes still held after the last event are released there. returns frames written or negative
+int sfxr_ExportSong(sfxr_Sequencer * sequencer, sfxr_Event const* events, int count, int wav_bits, const char * filename);
+#endif
+
+/*
+ * Standard MIDI File (type 0 or 1) player, feeds the notes of the file into a sequencer as it renders.
+ * Reads straight out of the file's bytes which must stay alive while it plays. The tracks are merged
+ * into a window of SFXR_MIDI_EVENTS events at a time so memory use doesn't depend on the length of the song.
+ * Only note on/off and tempo changes are used, midi channel c plays sequencer instrument c unless remapped.
+ */
+#ifndef SFXR_MIDI_TRACKS
+#define SFXR_MIDI_TRACKS 64
+#endif
+#define SFXR_MIDI_EVENTS 256
+
+typedef struct sfxr_MidiTrack
+{
+	unsigned char const* read; // null once the track has ended
+	unsigned char const* end;
+	unsigned long long tick;   // of the event at read
+	unsigned char status;	   // for running status
+} sfxr_MidiTrack;
+
+typedef struct sfxr_MidiPlayer
+{
+	sfxr_Sequencer * sequencer;
+	sfxr_MidiTrack tracks[SFXR_MIDI_TRACKS];
+	int track_count;
+	int division;
+	unsigned char instruments[SFXR_SEQUENCER_CHANNELS];
+
+	sfxr_Event events[SFXR_MIDI_EVENTS];
+	int event_count;
+	int event_read;
+
+// decoding stops at a tempo change until the sequencer gets there
+	int tempo_pending;
+	unsigned long long tempo_tick;
+	double tempo;
+	int released;
+} sfxr_MidiPlayer;
+
+// parses the header and restarts the sequencer's clock at the start of the song.
+// returns negative if data isn't a type 0 or 1 midi file
+int sfxr_MidiOpen(sfxr_MidiPlayer * player, sfxr_Sequencer * sequencer, void const* data, size_t size);
+int sfxr_MidiSetInstrument(sfxr_MidiPlayer * player, int channel, int instrument);
+// overwrites out with the next frames of interleaved stereo.
+// returns frames written, fewer than frames once the song is over and every note has died away, negative on failure
+int sfxr_MidiRender(sfxr_MidiPlayer * player, float * out, int frames);
+
+#if INCLUDE_WAV_EXPORT
+// renders the midi file in data through the sequencer's instruments into a stereo wav, returns frames written or negative
+int sfxr_ExportMidi(sfxr_Sequencer * sequencer, void const* data, size_t size, int wav_bits, const char * filename);
+#endif
+#endif
+
 
 #ifdef __cplusplus
 }